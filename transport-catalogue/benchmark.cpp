@@ -0,0 +1,221 @@
+#include "json.h"
+#include "json_reader.h"
+#include "map_renderer.h"
+#include "request_handler.h"
+#include "serialization.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+/*
+ * Бенчмарк на синтетическом городе: остановки раскладываются решёткой,
+ * маршруты идут последовательными цепочками остановок, дорожные расстояния
+ * заданы между всеми соседними по номеру остановками. Каждая фаза замеряется
+ * отдельно (время стены, пиковый RSS процесса, операции в секунду), чтобы
+ * отслеживать масштабирование от релиза к релизу.
+ *
+ * Запуск: transport_catalogue_bench [stops] [buses] [stops_per_bus] [engine]
+ * где engine — all_pairs (по умолчанию) или dijkstra.
+ */
+
+using namespace std;
+using namespace transport_catalogue;
+using namespace renderer;
+
+namespace {
+
+constexpr const char* DB_FILE = "transport_catalogue_bench.db";
+
+// Пиковый RSS процесса в мегабайтах; на Linux ru_maxrss — в килобайтах.
+double PeakRssMb() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<double>(usage.ru_maxrss) / 1024.0;
+}
+
+class Bench {
+public:
+    // Выполняет fn, печатая строку отчёта; ops — число операций за фазу
+    // (0 — фаза штучная, ops/sec не печатается).
+    template <typename Fn>
+    void Phase(string name, size_t ops, Fn&& fn) {
+        const auto start = chrono::steady_clock::now();
+        fn();
+        const auto stop = chrono::steady_clock::now();
+        const double wall_ms = chrono::duration<double, milli>(stop - start).count();
+
+        cout << name << ": " << wall_ms << " ms";
+        if (ops > 0 && wall_ms > 0.0) {
+            cout << ", " << static_cast<size_t>(ops / (wall_ms / 1000.0)) << " ops/sec";
+        }
+        cout << ", peak rss " << PeakRssMb() << " MB" << endl;
+    }
+};
+
+string StopName(size_t id) {
+    return "Stop "s + to_string(id);
+}
+
+string BusName(size_t id) {
+    return "Bus "s + to_string(id);
+}
+
+// Собирает полный входной документ make_base: base_requests c решёткой
+// остановок и цепочечными маршрутами плюс секции настроек.
+string GenerateCity(size_t stop_count, size_t bus_count, size_t stops_per_bus,
+                    const string& engine) {
+    ostringstream out;
+    const size_t side = max<size_t>(1, static_cast<size_t>(sqrt(static_cast<double>(stop_count))));
+
+    out << "{\"base_requests\":[";
+    for (size_t i = 0; i < stop_count; ++i) {
+        if (i > 0) {
+            out << ",";
+        }
+        const size_t row = i / side;
+        const size_t col = i % side;
+        out << "{\"type\":\"Stop\",\"name\":\"" << StopName(i) << "\""
+            << ",\"latitude\":" << 55.5 + 0.001 * static_cast<double>(row)
+            << ",\"longitude\":" << 37.5 + 0.001 * static_cast<double>(col)
+            << ",\"road_distances\":{";
+        if (i + 1 < stop_count) {
+            out << "\"" << StopName(i + 1) << "\":" << 600 + i % 150;
+        }
+        out << "}}";
+    }
+    for (size_t b = 0; b < bus_count; ++b) {
+        // Начало цепочки выбирается так, чтобы маршрут не выходил за последнюю
+        // остановку: расстояния заданы только между соседними по номеру.
+        const size_t first = (b * 37) % (stop_count - stops_per_bus + 1);
+        out << ",{\"type\":\"Bus\",\"name\":\"" << BusName(b)
+            << "\",\"is_roundtrip\":false,\"stops\":[";
+        for (size_t s = 0; s < stops_per_bus; ++s) {
+            if (s > 0) {
+                out << ",";
+            }
+            out << "\"" << StopName(first + s) << "\"";
+        }
+        out << "]}";
+    }
+    out << "]";
+
+    out << ",\"render_settings\":{\"width\":1200,\"height\":500,\"padding\":50,"
+           "\"line_width\":14,\"stop_radius\":5,\"bus_label_font_size\":20,"
+           "\"bus_label_offset\":[7,15],\"stop_label_font_size\":18,"
+           "\"stop_label_offset\":[7,-3],\"underlayer_color\":[255,255,255,0.85],"
+           "\"underlayer_width\":3,\"color_palette\":[\"green\",[255,160,0],\"red\"]}";
+    out << ",\"routing_settings\":{\"bus_wait_time\":2,\"bus_velocity\":30,"
+           "\"router_engine\":\"" << engine << "\"}";
+    out << ",\"serialization_settings\":{\"file\":\"" << DB_FILE << "\"}";
+    out << "}";
+    return out.str();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    size_t stop_count = argc > 1 ? static_cast<size_t>(atoll(argv[1])) : 1000;
+    size_t bus_count = argc > 2 ? static_cast<size_t>(atoll(argv[2])) : 100;
+    size_t stops_per_bus = argc > 3 ? static_cast<size_t>(atoll(argv[3])) : 20;
+    stops_per_bus = min(stops_per_bus, stop_count);
+    const string engine = argc > 4 ? argv[4] : "all_pairs"s;
+
+    cout << "synthetic city: " << stop_count << " stops, " << bus_count << " buses, "
+         << stops_per_bus << " stops/bus, engine " << engine << endl;
+
+    const string city = GenerateCity(stop_count, bus_count, stops_per_bus, engine);
+    Bench bench;
+
+    TransportCatalogue catalogue;
+    optional<json::Document> document;
+    bench.Phase("parse_base", stop_count + bus_count, [&] {
+        istringstream input(city);
+        document.emplace(ParseBaseRequests(catalogue, input));
+        catalogue.BuildBusStats();
+    });
+
+    MapRenderer map_renderer(ParseRenderSettings(*document));
+
+    optional<TransportRouter> transport_router;
+    bench.Phase("router_build", 0, [&] {
+        transport_router.emplace(ParseRoutingSettings(*document), catalogue);
+    });
+
+    bench.Phase("serialize", 0, [&] {
+        ofstream ofs(DB_FILE, ios::binary);
+        transport_catalogue_serialize::Serialize(catalogue, map_renderer, *transport_router, ofs);
+    });
+
+    optional<transport_catalogue_serialize::DeserializeResult> database;
+    bench.Phase("deserialize", 0, [&] {
+        auto result = transport_catalogue_serialize::Deserialize(DB_FILE);
+        if (!result) {
+            cerr << "failed to reopen " << DB_FILE << endl;
+            exit(1);
+        }
+        database.emplace(std::move(*result));
+    });
+
+    const RequestHandler handler(database->transport_catalogue, database->map_renderer,
+                                 database->route_manager);
+
+    constexpr size_t LOOKUP_ROUNDS = 100;
+    bench.Phase("get_bus_stat", bus_count * LOOKUP_ROUNDS, [&] {
+        for (size_t round = 0; round < LOOKUP_ROUNDS; ++round) {
+            for (size_t b = 0; b < bus_count; ++b) {
+                handler.GetBusStat(BusName(b));
+            }
+        }
+    });
+
+    bench.Phase("get_buses_by_stop", stop_count * LOOKUP_ROUNDS, [&] {
+        for (size_t round = 0; round < LOOKUP_ROUNDS; ++round) {
+            for (size_t i = 0; i < stop_count; ++i) {
+                handler.GetBusesByStop(StopName(i));
+            }
+        }
+    });
+
+    const size_t route_queries = max<size_t>(1000, bus_count * 10);
+    bench.Phase("build_route", route_queries, [&] {
+        mt19937 rng(42);
+        uniform_int_distribution<size_t> pick(0, stop_count - 1);
+        for (size_t i = 0; i < route_queries; ++i) {
+            handler.BuildRoute(StopName(pick(rng)), StopName(pick(rng)));
+        }
+    });
+
+    // Тот же набор запросов через пакетный API: буферы живут между батчами,
+    // в устоявшемся режиме обработка идёт без аллокаций.
+    bench.Phase("build_route_batch", route_queries, [&] {
+        mt19937 rng(42);
+        uniform_int_distribution<size_t> pick(0, stop_count - 1);
+
+        vector<pair<StopPtr, StopPtr>> queries;
+        queries.reserve(route_queries);
+        for (size_t i = 0; i < route_queries; ++i) {
+            queries.emplace_back(&database->transport_catalogue.FindStop(StopName(pick(rng))),
+                                 &database->transport_catalogue.FindStop(StopName(pick(rng))));
+        }
+
+        TransportRouter::RouteBatchBuffers buffers;
+        database->route_manager.BuildRoutes(queries, buffers);
+    });
+
+    bench.Phase("render_map", 0, [&] {
+        ostringstream svg_out;
+        handler.RenderMap().Render(svg_out);
+    });
+}
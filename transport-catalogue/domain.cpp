@@ -20,16 +20,4 @@ bool StopComparator::operator()(StopPtr lhs, StopPtr rhs) const {
     return lhs->name < rhs->name;
 }
 
-vector<StopPtr> MakeRoute(BusPtr bus) {
-    std::vector<StopPtr> stops;
-    MakeRoute(bus->stops.begin(), bus->stops.end(), stops, bus->is_roundtrip);
-    return stops;
-}
-
-vector<StopPtr> MakeRoute(const Bus& bus) {
-    std::vector<StopPtr> stops;
-    MakeRoute(bus.stops.begin(), bus.stops.end(), stops, bus.is_roundtrip);
-    return stops;
-}
-
 } // namespace transport_catalogue
@@ -2,6 +2,8 @@
 
 #include "geo.h"
 
+#include <cstddef>
+#include <iterator>
 #include <string>
 #include <string_view>
 #include <set>
@@ -20,15 +22,21 @@
 
 namespace transport_catalogue {
 
+// Имена — string_view в арену имён TransportCatalogue (см. StringArena):
+// каталог интернирует их при AddStop/AddBus, адреса стабильны всё время
+// жизни каталога.
 struct Stop {
-    std::string name;
+    std::string_view name;
     geo::Coordinates coordinates;
+    // Плотный номер остановки в порядке добавления; присваивается каталогом
+    // в AddStop и используется как индекс в таблице дистанций.
+    size_t id = 0;
 };
 
 using StopPtr = const Stop*;
 
 struct Bus {
-    std::string name;
+    std::string_view name;
     bool is_roundtrip;
     std::vector<StopPtr> stops;
 };
@@ -46,21 +54,78 @@ struct StopComparator {
     bool operator()(StopPtr lhs, StopPtr rhs) const;
 };
 
-std::vector<StopPtr> MakeRoute(BusPtr bus);
-std::vector<StopPtr> MakeRoute(const Bus& bus);
+/*
+ * Полный проход маршрута без материализации: итерирует Bus::stops напрямую,
+ * а для некольцевого маршрута виртуально дописывает обратный проход без
+ * повторения конечной остановки. Ни копий вектора, ни рекурсии — view живёт,
+ * пока жив сам Bus.
+ */
+class RouteView {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = StopPtr;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const StopPtr*;
+        using reference = StopPtr;
 
-template<typename Iterator>
-void MakeRoute(Iterator first, Iterator last, std::vector<StopPtr> &out_stops, bool is_roundtrip) {
-    if (first == last) {
-        return;
-    }
+        Iterator() = default;
+
+        Iterator(const std::vector<StopPtr>* stops, size_t pos)
+            : stops_(stops)
+            , pos_(pos) {
+        }
+
+        StopPtr operator*() const {
+            const size_t forward = stops_->size();
+            return pos_ < forward ? (*stops_)[pos_] : (*stops_)[2 * forward - 2 - pos_];
+        }
+
+        Iterator& operator++() { ++pos_; return *this; }
+        Iterator operator++(int) { auto copy = *this; ++pos_; return copy; }
+        Iterator& operator--() { --pos_; return *this; }
+        Iterator operator--(int) { auto copy = *this; --pos_; return copy; }
+
+        Iterator& operator+=(difference_type n) { pos_ += n; return *this; }
+        Iterator& operator-=(difference_type n) { pos_ -= n; return *this; }
+        Iterator operator+(difference_type n) const { return {stops_, pos_ + n}; }
+        Iterator operator-(difference_type n) const { return {stops_, pos_ - n}; }
 
-    out_stops.push_back(*first);
-    MakeRoute(next(first), last, out_stops, is_roundtrip);
+        difference_type operator-(const Iterator& other) const {
+            return static_cast<difference_type>(pos_) - static_cast<difference_type>(other.pos_);
+        }
 
-    if (!is_roundtrip && next(first) != last) {
-        out_stops.push_back(*first);
+        StopPtr operator[](difference_type n) const { return *(*this + n); }
+
+        bool operator==(const Iterator& other) const { return pos_ == other.pos_; }
+        bool operator!=(const Iterator& other) const { return pos_ != other.pos_; }
+        bool operator<(const Iterator& other) const { return pos_ < other.pos_; }
+        bool operator>(const Iterator& other) const { return pos_ > other.pos_; }
+        bool operator<=(const Iterator& other) const { return pos_ <= other.pos_; }
+        bool operator>=(const Iterator& other) const { return pos_ >= other.pos_; }
+
+    private:
+        const std::vector<StopPtr>* stops_ = nullptr;
+        size_t pos_ = 0;
+    };
+
+    explicit RouteView(const Bus& bus)
+        : stops_(&bus.stops)
+        , size_(bus.stops.empty() ? 0
+                : bus.is_roundtrip ? bus.stops.size()
+                                   : bus.stops.size() * 2 - 1) {
     }
-}
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    Iterator begin() const { return {stops_, 0}; }
+    Iterator end() const { return {stops_, size_}; }
+
+private:
+    const std::vector<StopPtr>* stops_;
+    size_t size_;
+};
 
 } // namespace transport_catalogue
@@ -16,4 +16,37 @@ double ComputeDistance(Coordinates from, Coordinates to) {
         * SPHERE_RADIUS;
 }
 
+double ComputeRouteDistance(const Coordinates* points, std::size_t count) {
+    using namespace std;
+    if (count < 2) {
+        return 0;
+    }
+
+    static const double dr = M_PI / 180.;
+
+    // Векторизовать сам haversine не выходит: у libm нет пакетных
+    // sin/cos/acos, а полиномиальные приближения изменили бы ответы в
+    // младших битах. Вместо этого тригонометрия каждой точки считается
+    // один раз и переиспользуется соседними звеньями.
+    double prev_sin = sin(points[0].lat * dr);
+    double prev_cos = cos(points[0].lat * dr);
+
+    double total = 0;
+    for (size_t i = 1; i < count; ++i) {
+        const double curr_sin = sin(points[i].lat * dr);
+        const double curr_cos = cos(points[i].lat * dr);
+
+        if (points[i - 1] != points[i]) {
+            total += acos(prev_sin * curr_sin
+                          + prev_cos * curr_cos * cos(abs(points[i - 1].lng - points[i].lng) * dr))
+                * SPHERE_RADIUS;
+        }
+
+        prev_sin = curr_sin;
+        prev_cos = curr_cos;
+    }
+
+    return total;
+}
+
 }  // namespace geo
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+
 namespace geo {
 
 const int SPHERE_RADIUS = 6371000;
@@ -17,4 +19,10 @@ struct Coordinates {
 
 double ComputeDistance(Coordinates from, Coordinates to);
 
+// Суммарная длина ломаной points[0]..points[count-1] по дуге сферы.
+// Эквивалентно сумме ComputeDistance по соседним парам, но синус и косинус
+// широты каждой внутренней точки считаются один раз, а не дважды —
+// тригонометрия доминирует в этом расчёте.
+double ComputeRouteDistance(const Coordinates* points, std::size_t count);
+
 }  // namespace geo
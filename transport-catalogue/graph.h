@@ -4,6 +4,8 @@
 
 #include <cstddef>
 #include <cstdlib>
+#include <numeric>
+#include <stdexcept>
 #include <vector>
 
 namespace graph {
@@ -18,6 +20,11 @@ struct Edge {
     Weight weight;
 };
 
+// Граф строится в две фазы: AddEdge накапливает рёбра, Finalize укладывает
+// списки смежности в CSR-форму — один плоский массив номеров рёбер плюс
+// массив смещений размера V+1. Это одна аллокация вместо аллокации на
+// вершину, и GetIncidentEdges отдаёт срез плоского массива без лишней
+// косвенности на каждом обходе.
 template <typename Weight>
 class DirectedWeightedGraph {
 private:
@@ -30,6 +37,10 @@ public:
 
     EdgeId AddEdge(const Edge<Weight>& edge);
 
+    // Строит CSR-индекс по накопленным рёбрам; повторный вызов без новых
+    // рёбер — no-op. Внутри каждой вершины рёбра сохраняют порядок добавления.
+    void Finalize();
+
     size_t GetVertexCount() const;
     size_t GetEdgeCount() const;
     const Edge<Weight>& GetEdge(EdgeId edge_id) const;
@@ -37,25 +48,57 @@ public:
 
 private:
     std::vector<Edge<Weight>> edges_;
-    std::vector<IncidenceList> incidence_lists_;
+    size_t vertex_count_ = 0;
+
+    // CSR: номера рёбер вершины v — csr_edges_[csr_offsets_[v]..csr_offsets_[v+1]).
+    std::vector<EdgeId> csr_edges_;
+    std::vector<size_t> csr_offsets_;
+    bool finalized_ = false;
 };
 
 template <typename Weight>
 DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count) :
-    incidence_lists_(vertex_count) {
+    vertex_count_(vertex_count) {
 }
 
 template <typename Weight>
 EdgeId DirectedWeightedGraph<Weight>::AddEdge(const Edge<Weight>& edge) {
+    if (edge.from >= vertex_count_) {
+        throw std::out_of_range("Edge source vertex is out of range");
+    }
     edges_.push_back(edge);
-    const EdgeId id = edges_.size() - 1;
-    incidence_lists_.at(edge.from).push_back(id);
-    return id;
+    finalized_ = false;
+    return edges_.size() - 1;
+}
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::Finalize() {
+    if (finalized_) {
+        return;
+    }
+
+    // Подсчитывающая сортировка по from: сначала степени вершин со сдвигом
+    // на один, затем префиксные суммы дают смещения, вторым проходом рёбра
+    // раскладываются по своим диапазонам. Проход по возрастанию номеров
+    // рёбер — порядок внутри вершины стабилен.
+    csr_offsets_.assign(vertex_count_ + 1, 0);
+    for (const auto& edge : edges_) {
+        ++csr_offsets_[edge.from + 1];
+    }
+    std::partial_sum(csr_offsets_.begin(), csr_offsets_.end(), csr_offsets_.begin());
+
+    csr_edges_.resize(edges_.size());
+    std::vector<size_t> cursors(csr_offsets_.begin(), csr_offsets_.end() - 1);
+    for (EdgeId id = 0; id < edges_.size(); ++id) {
+        csr_edges_[cursors[edges_[id].from]++] = id;
+    }
+
+    finalized_ = true;
 }
 
 template <typename Weight>
 size_t DirectedWeightedGraph<Weight>::GetVertexCount() const {
-    return incidence_lists_.size();
+    return vertex_count_;
 }
 
 template <typename Weight>
@@ -71,6 +114,11 @@ const Edge<Weight>& DirectedWeightedGraph<Weight>::GetEdge(EdgeId edge_id) const
 template <typename Weight>
 typename DirectedWeightedGraph<Weight>::IncidentEdgesRange
 DirectedWeightedGraph<Weight>::GetIncidentEdges(VertexId vertex) const {
-    return ranges::AsRange(incidence_lists_.at(vertex));
+    if (!finalized_) {
+        throw std::logic_error("Graph is not finalized");
+    }
+    const auto first = csr_offsets_.at(vertex);
+    const auto last = csr_offsets_.at(vertex + 1);
+    return {csr_edges_.begin() + first, csr_edges_.begin() + last};
 }
 }  // namespace graph
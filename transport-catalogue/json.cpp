@@ -1,112 +1,314 @@
 #include "json.h"
 
-#include <iterator>
+#include <cctype>
+#include <charconv>
+#include <cstring>
 
 namespace json {
 
 namespace {
 using namespace std::literals;
 
-Node LoadNode(std::istream& input);
-Node LoadString(std::istream& input);
+/*
+ * Буферизованный лексер: поток вычитывается мегабайтными кусками во
+ * внутренний слэб, разбор идёт по сырым указателям — без сентри и
+ * виртуальных вызовов streambuf на каждый символ. Токен, порвавшийся на
+ * границе куска, дочитывается со сдвигом непросмотренного хвоста в начало
+ * буфера; числа парсятся from_chars прямо по месту, строки без
+ * экранирования копируются в результат одним куском.
+ *
+ * Load вызывают и посреди потока, чередуя с прямым чтением (json_reader
+ * разбирает документ по кускам), поэтому лексер обязан оставить позицию
+ * потока ровно за распарсенным значением. Для позиционируемых потоков
+ * (файл, stringstream) непросмотренный хвост слэба возвращается обратным
+ * seekg в деструкторе; непозиционируемые (pipe, терминал) читаются по
+ * одному символу — тогда заглядывание вперёд не превышает одного символа
+ * и отдаётся назад через sputbackc.
+ */
+class Lexer {
+public:
+    static constexpr int kEof = -1;
+
+    explicit Lexer(std::istream& input)
+        : input_(input)
+        , seekable_(input.rdbuf() != nullptr
+                    && input.rdbuf()->pubseekoff(0, std::ios_base::cur, std::ios_base::in)
+                        != std::streampos(-1)) {
+        buffer_.resize(seekable_ ? CHUNK_SIZE : 64);
+        pos_ = end_ = buffer_.data();
+    }
 
-std::string LoadLiteral(std::istream& input) {
-    std::string s;
-    while (std::isalpha(input.peek())) {
-        s.push_back(static_cast<char>(input.get()));
+    ~Lexer() {
+        const auto tail = end_ - pos_;
+        if (tail == 0) {
+            return;
+        }
+        if (seekable_) {
+            input_.clear();
+            input_.seekg(-tail, std::ios_base::cur);
+        } else {
+            for (const char* p = end_; p != pos_;) {
+                input_.rdbuf()->sputbackc(*--p);
+            }
+            input_.clear();
+        }
     }
-    return s;
-}
 
-Node LoadArray(std::istream& input) {
-    std::vector<Node> result;
+    Lexer(const Lexer&) = delete;
+    Lexer& operator=(const Lexer&) = delete;
 
-    for (char c; input >> c && c != ']';) {
-        if (c != ',') {
-            input.putback(c);
+    int Peek() {
+        if (pos_ == end_ && !Refill()) {
+            return kEof;
         }
-        result.push_back(LoadNode(input));
+        return static_cast<unsigned char>(*pos_);
     }
-    if (!input) {
-        throw ParsingError("Array parsing error"s);
+
+    int Get() {
+        const int c = Peek();
+        if (c != kEof) {
+            ++pos_;
+        }
+        return c;
     }
-    return Node(std::move(result));
-}
 
-Node LoadDict(std::istream& input) {
-    Dict dict;
+    // Возвращает только что съеденный символ обратно. Допустимо сразу после
+    // Get без промежуточных вызовов: буфер между ними не перечитывается.
+    void Unget() {
+        --pos_;
+    }
 
-    for (char c; input >> c && c != '}';) {
-        if (c == '"') {
-            std::string key = LoadString(input).AsString();
-            if (input >> c && c == ':') {
-                if (dict.find(key) != dict.end()) {
-                    throw ParsingError("Duplicate key '"s + key + "' have been found");
-                }
-                dict.emplace(std::move(key), LoadNode(input));
-            } else {
-                throw ParsingError(": is expected but '"s + c + "' has been found"s);
+    // Пропускает пробельные символы и съедает следующий значимый; kEof —
+    // поток закончился.
+    int GetNonWs() {
+        while (true) {
+            const int c = Get();
+            if (c == kEof || !std::isspace(c)) {
+                return c;
             }
-        } else if (c != ',') {
-            throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
         }
     }
-    if (!input) {
-        throw ParsingError("Dictionary parsing error"s);
-    }
-    return Node(std::move(dict));
-}
 
-Node LoadString(std::istream& input) {
-    auto it = std::istreambuf_iterator<char>(input);
-    auto end = std::istreambuf_iterator<char>();
-    std::string s;
-    while (true) {
-        if (it == end) {
-            throw ParsingError("String parsing error");
-        }
-        const char ch = *it;
-        if (ch == '"') {
-            ++it;
-            break;
-        } else if (ch == '\\') {
-            ++it;
-            if (it == end) {
-                throw ParsingError("String parsing error");
+    // Строка без экранирования отдаётся одним assign по найденной длине;
+    // накопление посимвольно — только вокруг escape-последовательностей и
+    // на границах кусков.
+    std::string LexString() {
+        std::string result;
+        bool copied = false;
+        while (true) {
+            const char* p = pos_;
+            while (p != end_ && *p != '"' && *p != '\\' && *p != '\n' && *p != '\r') {
+                ++p;
+            }
+
+            if (p == end_) {
+                result.append(pos_, p);
+                copied = true;
+                pos_ = p;
+                if (!Refill()) {
+                    throw ParsingError("String parsing error");
+                }
+                continue;
+            }
+
+            if (*p == '"') {
+                if (copied) {
+                    result.append(pos_, p);
+                } else {
+                    result.assign(pos_, p);
+                }
+                pos_ = p + 1;
+                return result;
+            }
+
+            if (*p == '\n' || *p == '\r') {
+                throw ParsingError("Unexpected end of line"s);
             }
-            const char escaped_char = *(it);
+
+            result.append(pos_, p);
+            copied = true;
+            pos_ = p + 1;
+            const int escaped_char = Get();
             switch (escaped_char) {
                 case 'n':
-                    s.push_back('\n');
+                    result.push_back('\n');
                     break;
                 case 't':
-                    s.push_back('\t');
+                    result.push_back('\t');
                     break;
                 case 'r':
-                    s.push_back('\r');
+                    result.push_back('\r');
                     break;
                 case '"':
-                    s.push_back('"');
+                    result.push_back('"');
                     break;
                 case '\\':
-                    s.push_back('\\');
+                    result.push_back('\\');
                     break;
+                case kEof:
+                    throw ParsingError("String parsing error");
                 default:
-                    throw ParsingError("Unrecognized escape sequence \\"s + escaped_char);
+                    throw ParsingError("Unrecognized escape sequence \\"s
+                                       + static_cast<char>(escaped_char));
+            }
+        }
+    }
+
+    std::string LexLiteral() {
+        while (true) {
+            const char* p = pos_;
+            while (p != end_ && std::isalpha(static_cast<unsigned char>(*p))) {
+                ++p;
+            }
+            if (p != end_) {
+                std::string s(pos_, p);
+                pos_ = p;
+                return s;
+            }
+            // Литерал упёрся в конец буфера — дочитываем и рескан. Refill
+            // сдвигает хвост в начало буфера даже при неудаче, поэтому p
+            // устарел: при исчерпанном потоке токен — весь остаток [pos_, end_).
+            if (!Refill()) {
+                std::string s(pos_, end_);
+                pos_ = end_;
+                return s;
+            }
+        }
+    }
+
+    Node LexNumber() {
+        const char* token_end;
+        while (true) {
+            const char* p = pos_;
+            while (p != end_ && IsNumberChar(*p)) {
+                ++p;
+            }
+            if (p != end_) {
+                token_end = p;
+                break;
+            }
+            // См. LexLiteral: после неудачного Refill p указывает в старую
+            // раскладку буфера — концом токена служит новый end_.
+            if (!Refill()) {
+                token_end = end_;
+                break;
+            }
+        }
+
+        // Структурная проверка повторяет прежний посимвольный разбор: тот же
+        // набор ошибок, и съедается ровно корректный префикс токена.
+        const char* const start = pos_;
+        const char* q = start;
+        auto require_digits = [&] {
+            if (q == token_end || !std::isdigit(static_cast<unsigned char>(*q))) {
+                throw ParsingError("A digit is expected"s);
             }
-        } else if (ch == '\n' || ch == '\r') {
-            throw ParsingError("Unexpected end of line"s);
+            while (q != token_end && std::isdigit(static_cast<unsigned char>(*q))) {
+                ++q;
+            }
+        };
+
+        if (q != token_end && *q == '-') {
+            ++q;
+        }
+        if (q != token_end && *q == '0') {
+            // После 0 в JSON не могут идти другие цифры
+            ++q;
         } else {
-            s.push_back(ch);
+            require_digits();
+        }
+
+        bool is_int = true;
+        if (q != token_end && *q == '.') {
+            ++q;
+            require_digits();
+            is_int = false;
+        }
+        if (q != token_end && (*q == 'e' || *q == 'E')) {
+            ++q;
+            if (q != token_end && (*q == '+' || *q == '-')) {
+                ++q;
+            }
+            require_digits();
+            is_int = false;
+        }
+        pos_ = q;
+
+        if (is_int) {
+            int value = 0;
+            if (const auto [ptr, ec] = std::from_chars(start, q, value);
+                    ec == std::errc{} && ptr == q) {
+                return Node{value};
+            }
+            // Переполнение int — ниже токен прочитается как double.
+        }
+
+        double value = 0.0;
+        if (const auto [ptr, ec] = std::from_chars(start, q, value);
+                ec != std::errc{} || ptr != q) {
+            throw ParsingError("Failed to convert "s + std::string(start, q) + " to number"s);
+        }
+        return Node{value};
+    }
+
+private:
+    static constexpr size_t CHUNK_SIZE = 1 << 20;
+
+    static bool IsNumberChar(char c) {
+        return std::isdigit(static_cast<unsigned char>(c))
+            || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+    }
+
+    // Догружает следующий кусок потока, сохраняя непросмотренный хвост
+    // [pos_, end_) в начале буфера. false — данных в потоке больше нет.
+    bool Refill() {
+        const size_t tail = static_cast<size_t>(end_ - pos_);
+        if (tail > 0 && pos_ != buffer_.data()) {
+            std::memmove(buffer_.data(), pos_, tail);
+        }
+        // Токен длиннее буфера целиком — расширяем слэб.
+        if (tail == buffer_.size()) {
+            buffer_.resize(buffer_.size() * 2);
         }
-        ++it;
+
+        // Непозиционируемый поток читается по символу: лишнее из него не
+        // вернуть, а заглядывание на один символ компенсирует sputbackc.
+        const size_t to_read = seekable_ ? buffer_.size() - tail : 1;
+        input_.read(buffer_.data() + tail, static_cast<std::streamsize>(to_read));
+        const size_t got = static_cast<size_t>(input_.gcount());
+
+        pos_ = buffer_.data();
+        end_ = buffer_.data() + tail + got;
+        return got > 0;
     }
 
-    return Node(std::move(s));
+    std::istream& input_;
+    const bool seekable_;
+    std::string buffer_;
+    const char* pos_ = nullptr;
+    const char* end_ = nullptr;
+};
+
+Node LoadNode(Lexer& lexer);
+
+Node LoadArray(Lexer& lexer) {
+    std::vector<Node> result;
+
+    int c;
+    while ((c = lexer.GetNonWs()) != Lexer::kEof && c != ']') {
+        if (c != ',') {
+            lexer.Unget();
+        }
+        result.push_back(LoadNode(lexer));
+    }
+    if (c == Lexer::kEof) {
+        throw ParsingError("Array parsing error"s);
+    }
+    return Node(std::move(result));
 }
 
-Node LoadBool(std::istream& input) {
-    const auto s = LoadLiteral(input);
+Node LoadBool(Lexer& lexer) {
+    const auto s = lexer.LexLiteral();
     if (s == "true"sv) {
         return Node{true};
     } else if (s == "false"sv) {
@@ -116,109 +318,135 @@ Node LoadBool(std::istream& input) {
     }
 }
 
-Node LoadNull(std::istream& input) {
-    if (auto literal = LoadLiteral(input); literal == "null"sv) {
+Node LoadNull(Lexer& lexer) {
+    if (auto literal = lexer.LexLiteral(); literal == "null"sv) {
         return Node{nullptr};
     } else {
         throw ParsingError("Failed to parse '"s + literal + "' as null"s);
     }
 }
 
-Node LoadNumber(std::istream& input) {
-    std::string parsed_num;
-
-    // Считывает в parsed_num очередной символ из input
-    auto read_char = [&parsed_num, &input] {
-        parsed_num += static_cast<char>(input.get());
-        if (!input) {
-            throw ParsingError("Failed to read number from stream"s);
-        }
-    };
+Node LoadDict(Lexer& lexer) {
+    Dict dict;
 
-    // Считывает одну или более цифр в parsed_num из input
-    auto read_digits = [&input, read_char] {
-        if (!std::isdigit(input.peek())) {
-            throw ParsingError("A digit is expected"s);
-        }
-        while (std::isdigit(input.peek())) {
-            read_char();
+    int c;
+    while ((c = lexer.GetNonWs()) != Lexer::kEof && c != '}') {
+        if (c == '"') {
+            std::string key = lexer.LexString();
+            if ((c = lexer.GetNonWs()) == ':') {
+                if (dict.find(key) != dict.end()) {
+                    throw ParsingError("Duplicate key '"s + key + "' have been found");
+                }
+                dict.emplace(std::move(key), LoadNode(lexer));
+            } else {
+                throw ParsingError(": is expected but '"s + static_cast<char>(c)
+                                   + "' has been found"s);
+            }
+        } else if (c != ',') {
+            throw ParsingError(R"(',' is expected but ')"s + static_cast<char>(c)
+                               + "' has been found"s);
         }
-    };
-
-    if (input.peek() == '-') {
-        read_char();
     }
-    // Парсим целую часть числа
-    if (input.peek() == '0') {
-        read_char();
-        // После 0 в JSON не могут идти другие цифры
-    } else {
-        read_digits();
+    if (c == Lexer::kEof) {
+        throw ParsingError("Dictionary parsing error"s);
     }
+    return Node(std::move(dict));
+}
 
-    bool is_int = true;
-    // Парсим дробную часть числа
-    if (input.peek() == '.') {
-        read_char();
-        read_digits();
-        is_int = false;
+Node LoadNode(Lexer& lexer) {
+    const int c = lexer.GetNonWs();
+    switch (c) {
+        case Lexer::kEof:
+            throw ParsingError("Unexpected EOF"s);
+        case '[':
+            return LoadArray(lexer);
+        case '{':
+            return LoadDict(lexer);
+        case '"':
+            return Node(lexer.LexString());
+        case 't':
+            [[fallthrough]];
+        case 'f':
+            lexer.Unget();
+            return LoadBool(lexer);
+        case 'n':
+            lexer.Unget();
+            return LoadNull(lexer);
+        default:
+            lexer.Unget();
+            return lexer.LexNumber();
     }
+}
 
-    // Парсим экспоненциальную часть числа
-    if (int ch = input.peek(); ch == 'e' || ch == 'E') {
-        read_char();
-        if (ch = input.peek(); ch == '+' || ch == '-') {
-            read_char();
+void LoadStreamNode(Lexer& lexer, EventHandler& handler);
+
+void LoadStreamArray(Lexer& lexer, EventHandler& handler) {
+    handler.StartArray();
+    int c;
+    while ((c = lexer.GetNonWs()) != Lexer::kEof && c != ']') {
+        if (c != ',') {
+            lexer.Unget();
         }
-        read_digits();
-        is_int = false;
+        LoadStreamNode(lexer, handler);
     }
+    if (c == Lexer::kEof) {
+        throw ParsingError("Array parsing error"s);
+    }
+    handler.EndArray();
+}
 
-    try {
-        if (is_int) {
-            // Сначала пробуем преобразовать строку в int
-            try {
-                return std::stoi(parsed_num);
-            } catch (...) {
-                // В случае неудачи, например, при переполнении
-                // код ниже попробует преобразовать строку в double
+void LoadStreamDict(Lexer& lexer, EventHandler& handler) {
+    handler.StartDict();
+    int c;
+    while ((c = lexer.GetNonWs()) != Lexer::kEof && c != '}') {
+        if (c == '"') {
+            std::string key = lexer.LexString();
+            if ((c = lexer.GetNonWs()) == ':') {
+                handler.Key(std::move(key));
+                LoadStreamNode(lexer, handler);
+            } else {
+                throw ParsingError(": is expected but '"s + static_cast<char>(c)
+                                   + "' has been found"s);
             }
+        } else if (c != ',') {
+            throw ParsingError(R"(',' is expected but ')"s + static_cast<char>(c)
+                               + "' has been found"s);
         }
-        return std::stod(parsed_num);
-    } catch (...) {
-        throw ParsingError("Failed to convert "s + parsed_num + " to number"s);
     }
+    if (c == Lexer::kEof) {
+        throw ParsingError("Dictionary parsing error"s);
+    }
+    handler.EndDict();
 }
 
-Node LoadNode(std::istream& input) {
-    char c;
-    if (!(input >> c)) {
-        throw ParsingError("Unexpected EOF"s);
-    }
+void LoadStreamNode(Lexer& lexer, EventHandler& handler) {
+    const int c = lexer.GetNonWs();
     switch (c) {
+        case Lexer::kEof:
+            throw ParsingError("Unexpected EOF"s);
         case '[':
-            return LoadArray(input);
+            LoadStreamArray(lexer, handler);
+            break;
         case '{':
-            return LoadDict(input);
+            LoadStreamDict(lexer, handler);
+            break;
         case '"':
-            return LoadString(input);
+            handler.Value(lexer.LexString());
+            break;
         case 't':
-            // Атрибут [[fallthrough]] (провалиться) ничего не делает, и является
-            // подсказкой компилятору и человеку, что здесь программист явно задумывал
-            // разрешить переход к инструкции следующей ветки case, а не случайно забыл
-            // написать break, return или throw.
-            // В данном случае, встретив t или f, переходим к попытке парсинга
-            // литералов true либо false
             [[fallthrough]];
         case 'f':
-            input.putback(c);
-            return LoadBool(input);
+            lexer.Unget();
+            handler.Value(LoadBool(lexer));
+            break;
         case 'n':
-            input.putback(c);
-            return LoadNull(input);
+            lexer.Unget();
+            handler.Value(LoadNull(lexer));
+            break;
         default:
-            input.putback(c);
-            return LoadNumber(input);
+            lexer.Unget();
+            handler.Value(lexer.LexNumber());
+            break;
     }
 }
 
@@ -245,6 +473,23 @@ void PrintValue(const Value& value, const PrintContext& ctx) {
     ctx.out << value;
 }
 
+template <>
+void PrintValue<int>(const int& value, const PrintContext& ctx) {
+    char buf[16];
+    const auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+    ctx.out.write(buf, ptr - buf);
+}
+
+template <>
+void PrintValue<double>(const double& value, const PrintContext& ctx) {
+    // Формат general с точностью 6 повторяет прежний вывод ostream,
+    // но без блокировок локали и виртуальных вызовов num_put.
+    char buf[32];
+    const auto [ptr, ec] =
+        std::to_chars(buf, buf + sizeof(buf), value, std::chars_format::general, 6);
+    ctx.out.write(buf, ptr - buf);
+}
+
 void PrintString(const std::string& value, std::ostream& out) {
     out.put('"');
     for (const char c : value) {
@@ -341,11 +586,21 @@ void PrintNode(const Node& node, const PrintContext& ctx) {
 }  // namespace
 
 Document Load(std::istream& input) {
-    return Document{LoadNode(input)};
+    Lexer lexer(input);
+    return Document{LoadNode(lexer)};
+}
+
+void Load(std::istream& input, EventHandler& handler) {
+    Lexer lexer(input);
+    LoadStreamNode(lexer, handler);
 }
 
 void Print(const Document& doc, std::ostream& output) {
     PrintNode(doc.GetRoot(), PrintContext{output});
 }
 
+void Print(const Node& node, std::ostream& output) {
+    PrintNode(node, PrintContext{output});
+}
+
 }  // namespace json
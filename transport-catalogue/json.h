@@ -1,17 +1,73 @@
 #pragma once
 
+#include <cstddef>
+#include <initializer_list>
 #include <iostream>
-#include <map>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
 #include <variant>
 #include <vector>
 
 namespace json {
 
 class Node;
-using Dict = std::map<std::string, Node>;
 using Array = std::vector<Node>;
 
+/*
+ * Словарь с сохранением порядка вставки: пары лежат в сплошном векторе,
+ * типичный ответ из 4-6 ключей обходится линейным поиском без узловых
+ * аллокаций дерева. Для крупных объектов при вставке строится хеш-индекс
+ * ключей, и поиск снова становится O(1).
+ */
+class Dict {
+public:
+    using value_type = std::pair<std::string, Node>;
+    using Storage = std::vector<value_type>;
+    using iterator = Storage::iterator;
+    using const_iterator = Storage::const_iterator;
+
+    Dict() = default;
+    Dict(std::initializer_list<value_type> values);
+
+    iterator begin() { return entries_.begin(); }
+    iterator end() { return entries_.end(); }
+    const_iterator begin() const { return entries_.begin(); }
+    const_iterator end() const { return entries_.end(); }
+
+    bool empty() const { return entries_.empty(); }
+    size_t size() const { return entries_.size(); }
+
+    Node& operator[](const std::string& key);
+    Node& at(std::string_view key);
+    const Node& at(std::string_view key) const;
+
+    iterator find(std::string_view key);
+    const_iterator find(std::string_view key) const;
+    size_t count(std::string_view key) const;
+
+    std::pair<iterator, bool> insert(value_type value);
+
+    template <typename K, typename V>
+    std::pair<iterator, bool> emplace(K&& key, V&& value);
+
+    bool operator==(const Dict& other) const;
+    bool operator!=(const Dict& other) const { return !(*this == other); }
+
+private:
+    static constexpr size_t NPOS = static_cast<size_t>(-1);
+    static constexpr size_t INDEX_THRESHOLD = 16;
+
+    size_t FindIndex(std::string_view key) const;
+    std::pair<iterator, bool> DoInsert(value_type value);
+
+    Storage entries_;
+    // Пуст, пока объект мал; ключи копируются, чтобы пережить реаллокации.
+    std::unordered_map<std::string, size_t> index_;
+};
+
 class ParsingError : public std::runtime_error {
 public:
     using runtime_error::runtime_error;
@@ -133,6 +189,93 @@ inline bool operator!=(const Node& lhs, const Node& rhs) {
     return !(lhs == rhs);
 }
 
+// Методы Dict определены после Node: им нужен полный тип значения.
+
+inline bool Dict::operator==(const Dict& other) const {
+    return entries_ == other.entries_;
+}
+
+inline Dict::Dict(std::initializer_list<value_type> values) {
+    for (const auto& value : values) {
+        insert(value);
+    }
+}
+
+inline size_t Dict::FindIndex(std::string_view key) const {
+    if (!index_.empty()) {
+        // Хеш-таблица не ищет по string_view — ключ материализуется, но
+        // этот путь включается только у больших объектов.
+        const auto it = index_.find(std::string(key));
+        return it != index_.end() ? it->second : NPOS;
+    }
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        if (entries_[i].first == key) {
+            return i;
+        }
+    }
+    return NPOS;
+}
+
+inline std::pair<Dict::iterator, bool> Dict::DoInsert(value_type value) {
+    if (const size_t index = FindIndex(value.first); index != NPOS) {
+        return {entries_.begin() + index, false};
+    }
+
+    entries_.push_back(std::move(value));
+    if (!index_.empty() || entries_.size() > INDEX_THRESHOLD) {
+        if (index_.empty()) {
+            for (size_t i = 0; i + 1 < entries_.size(); ++i) {
+                index_.emplace(entries_[i].first, i);
+            }
+        }
+        index_.emplace(entries_.back().first, entries_.size() - 1);
+    }
+    return {std::prev(entries_.end()), true};
+}
+
+inline std::pair<Dict::iterator, bool> Dict::insert(value_type value) {
+    return DoInsert(std::move(value));
+}
+
+template <typename K, typename V>
+std::pair<Dict::iterator, bool> Dict::emplace(K&& key, V&& value) {
+    return DoInsert({std::forward<K>(key), Node(std::forward<V>(value))});
+}
+
+inline Node& Dict::operator[](const std::string& key) {
+    return DoInsert({key, Node{}}).first->second;
+}
+
+inline Node& Dict::at(std::string_view key) {
+    const size_t index = FindIndex(key);
+    if (index == NPOS) {
+        throw std::out_of_range("No key '" + std::string(key) + "' in dict");
+    }
+    return entries_[index].second;
+}
+
+inline const Node& Dict::at(std::string_view key) const {
+    const size_t index = FindIndex(key);
+    if (index == NPOS) {
+        throw std::out_of_range("No key '" + std::string(key) + "' in dict");
+    }
+    return entries_[index].second;
+}
+
+inline Dict::iterator Dict::find(std::string_view key) {
+    const size_t index = FindIndex(key);
+    return index == NPOS ? entries_.end() : entries_.begin() + index;
+}
+
+inline Dict::const_iterator Dict::find(std::string_view key) const {
+    const size_t index = FindIndex(key);
+    return index == NPOS ? entries_.end() : entries_.begin() + index;
+}
+
+inline size_t Dict::count(std::string_view key) const {
+    return FindIndex(key) == NPOS ? 0 : 1;
+}
+
 class Document {
 public:
     explicit Document(Node root)
@@ -157,6 +300,34 @@ inline bool operator!=(const Document& lhs, const Document& rhs) {
 
 Document Load(std::istream& input);
 
+/*
+ * Интерфейс обработчика событий потокового (SAX-стиль) разбора: документ
+ * читается за один проход, DOM не строится, пиковая память ограничена
+ * обработчиком. Скалярные значения (null, bool, число, строка) приходят
+ * готовым Node, контейнеры — парными событиями Start/End.
+ */
+class EventHandler {
+public:
+    virtual ~EventHandler() = default;
+
+    virtual void StartDict() = 0;
+    virtual void Key(std::string key) = 0;
+    virtual void EndDict() = 0;
+
+    virtual void StartArray() = 0;
+    virtual void EndArray() = 0;
+
+    virtual void Value(Node value) = 0;
+};
+
+// Потоковый разбор: читает один JSON-документ из input, транслируя его
+// в события handler.
+void Load(std::istream& input, EventHandler& handler);
+
 void Print(const Document& doc, std::ostream& output);
 
+// Сериализует один узел без обёртки Document — удобно для поэлементного
+// вывода ответов, когда итоговый массив пишется в поток инкрементально.
+void Print(const Node& node, std::ostream& output);
+
 }  // namespace json
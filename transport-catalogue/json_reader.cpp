@@ -6,8 +6,17 @@
 #include "svg.h"
 #include "transport_catalogue.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
 #include <sstream>
+#include <thread>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 #include <set>
 
@@ -22,6 +31,245 @@ using namespace std;
 using namespace json;
 using namespace renderer;
 
+namespace {
+
+/*
+ * Ограниченная очередь остановок между парсером (producer) и построителем
+ * каталога (consumer): разбор JSON и наполнение каталога используют разные
+ * ресурсы (ввод-вывод и лексер против хеширования и аллокаций) и
+ * перекрываются. Ёмкость не даёт парсеру убегать вперёд и копить память.
+ * Имена передаются владеющими строками: DOM запроса разрушается сразу
+ * после разбора, а каталог интернирует имя при AddStop.
+ */
+class BoundedStopQueue {
+public:
+    struct Item {
+        std::string name;
+        geo::Coordinates coordinates;
+    };
+
+    explicit BoundedStopQueue(size_t capacity)
+        : capacity_(capacity) {
+    }
+
+    void Push(Item item) {
+        unique_lock lock(mutex_);
+        not_full_.wait(lock, [this] { return items_.size() < capacity_; });
+        items_.push_back(std::move(item));
+        not_empty_.notify_one();
+    }
+
+    bool Pop(Item& item) {
+        unique_lock lock(mutex_);
+        not_empty_.wait(lock, [this] { return !items_.empty() || closed_; });
+        if (items_.empty()) {
+            return false;
+        }
+        item = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void Close() {
+        lock_guard lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+    }
+
+private:
+    const size_t capacity_;
+    std::deque<Item> items_;
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    bool closed_ = false;
+};
+
+/*
+ * SAX-обработчик документа make_base. Остановки добавляются в каталог сразу
+ * после завершения объекта запроса; дистанции и автобусы могут ссылаться на
+ * ещё не объявленные остановки, поэтому сохраняются в компактные описания
+ * (имена и числа, без DOM) и применяются после конца документа. Секции,
+ * отличные от base_requests, собираются в обычный DOM и возвращаются
+ * вызывающему.
+ */
+class BaseRequestsHandler final : public json::EventHandler {
+public:
+    // stop_sink, если задан, получает разобранные остановки вместо прямого
+    // вызова catalogue.AddStop — так парсер отдаёт их конвейеру.
+    explicit BaseRequestsHandler(TransportCatalogue& catalogue,
+                                 std::function<void(std::string, geo::Coordinates)> stop_sink = nullptr)
+        : catalogue_(catalogue)
+        , stop_sink_(move(stop_sink)) {
+    }
+
+    void StartDict() override {
+        ++depth_;
+        if (depth_ == 1) {
+            leftover_.StartDict();
+            return;
+        }
+        if (in_base_requests_) {
+            if (request_depth_ == 0) {
+                request_.emplace();
+            }
+            request_->StartDict();
+            ++request_depth_;
+        } else {
+            leftover_.StartDict();
+        }
+    }
+
+    void Key(std::string key) override {
+        if (depth_ == 1) {
+            if (key == "base_requests"s) {
+                in_base_requests_ = true;
+            } else {
+                leftover_.Key(move(key));
+            }
+            return;
+        }
+        if (in_base_requests_) {
+            request_->Key(move(key));
+        } else {
+            leftover_.Key(move(key));
+        }
+    }
+
+    void EndDict() override {
+        --depth_;
+        if (in_base_requests_) {
+            request_->EndDict();
+            --request_depth_;
+            if (request_depth_ == 0) {
+                DispatchRequest(request_->Build());
+                request_.reset();
+            }
+        } else {
+            leftover_.EndDict();
+        }
+    }
+
+    void StartArray() override {
+        ++depth_;
+        if (in_base_requests_) {
+            if (request_depth_ == 0) {
+                // Сам массив base_requests: элементы обрабатываются поштучно.
+                return;
+            }
+            request_->StartArray();
+            ++request_depth_;
+        } else {
+            leftover_.StartArray();
+        }
+    }
+
+    void EndArray() override {
+        --depth_;
+        if (in_base_requests_) {
+            if (request_depth_ == 0) {
+                in_base_requests_ = false;
+                return;
+            }
+            request_->EndArray();
+            --request_depth_;
+        } else {
+            leftover_.EndArray();
+        }
+    }
+
+    void Value(json::Node value) override {
+        if (in_base_requests_) {
+            if (request_depth_ > 0) {
+                request_->Value(move(value.GetValue()));
+            }
+        } else {
+            leftover_.Value(move(value.GetValue()));
+        }
+    }
+
+    // Применяет отложенные дистанции и автобусы; зовётся после конца документа,
+    // когда все остановки уже в каталоге.
+    void ApplyDeferredRequests() {
+        for (const auto& [from, distances] : pending_distances_) {
+            for (const auto& [to, distance] : distances) {
+                catalogue_.SetDistance(catalogue_.FindStop(from), catalogue_.FindStop(to), distance);
+            }
+        }
+        pending_distances_.clear();
+
+        for (auto& [name, is_roundtrip, stop_names] : pending_buses_) {
+            vector<StopPtr> stops;
+            stops.reserve(stop_names.size());
+            for (const auto& stop_name : stop_names) {
+                stops.push_back(&catalogue_.FindStop(stop_name));
+            }
+            catalogue_.AddBus({move(name), is_roundtrip, move(stops)});
+        }
+        pending_buses_.clear();
+    }
+
+    json::Document ReleaseDocument() {
+        return json::Document{leftover_.Build()};
+    }
+
+private:
+    struct PendingBus {
+        std::string name;
+        bool is_roundtrip;
+        std::vector<std::string> stop_names;
+    };
+
+    void DispatchRequest(const json::Node& request) {
+        const auto& dict = request.AsDict();
+        const auto& type = dict.at("type"s).AsString();
+
+        if (type == "Stop"s) {
+            const geo::Coordinates coordinates{
+                dict.at("latitude"s).AsDouble(),
+                dict.at("longitude"s).AsDouble()
+            };
+            if (stop_sink_) {
+                stop_sink_(dict.at("name"s).AsString(), coordinates);
+            } else {
+                catalogue_.AddStop({dict.at("name"s).AsString(), coordinates});
+            }
+
+            if (auto it = dict.find("road_distances"s); it != dict.end()) {
+                vector<pair<string, double>> distances;
+                for (const auto& [to, distance] : it->second.AsDict()) {
+                    distances.emplace_back(to, distance.AsDouble());
+                }
+                if (!distances.empty()) {
+                    pending_distances_.emplace_back(dict.at("name"s).AsString(), move(distances));
+                }
+            }
+        } else if (type == "Bus"s) {
+            PendingBus bus{dict.at("name"s).AsString(), dict.at("is_roundtrip"s).AsBool(), {}};
+            for (const auto& stop_name : dict.at("stops"s).AsArray()) {
+                bus.stop_names.push_back(stop_name.AsString());
+            }
+            pending_buses_.push_back(move(bus));
+        }
+    }
+
+    TransportCatalogue& catalogue_;
+    std::function<void(std::string, geo::Coordinates)> stop_sink_;
+
+    json::Builder leftover_;
+    std::optional<json::Builder> request_;
+
+    int depth_ = 0;
+    int request_depth_ = 0;
+    bool in_base_requests_ = false;
+
+    std::vector<std::pair<std::string, std::vector<std::pair<std::string, double>>>> pending_distances_;
+    std::vector<PendingBus> pending_buses_;
+};
+
+} // namespace
+
 RenderSettings ParseRenderSettings(const json::Document& document) {
     const auto& settings = document.GetRoot().AsDict().at("render_settings"s).AsDict();
     vector<svg::Color> color_palette;
@@ -46,16 +294,40 @@ RenderSettings ParseRenderSettings(const json::Document& document) {
 
 transport_catalogue::SerializationSettings ParseSerializationSettings(const json::Document& document) {
     const auto& settings = document.GetRoot().AsDict().at("serialization_settings"s).AsDict();
+
+    size_t thread_count = 1;
+    if (auto it = settings.find("thread_count"s); it != settings.end()) {
+        const int value = it->second.AsInt();
+        thread_count = value > 0 ? static_cast<size_t>(value)
+                                 : static_cast<size_t>(thread::hardware_concurrency());
+    }
+
+    bool compact_router = false;
+    if (auto it = settings.find("compact_router"s); it != settings.end()) {
+        compact_router = it->second.AsBool();
+    }
+
     return {
-        settings.at("file"s).AsString()
+        settings.at("file"s).AsString(),
+        thread_count,
+        compact_router
     };
 }
 
 transport_catalogue::RoutingSettings ParseRoutingSettings(const json::Document& document) {
     const auto& settings = document.GetRoot().AsDict().at("routing_settings"s).AsDict();
+
+    auto engine = RouterEngine::AllPairs;
+    if (auto it = settings.find("router_engine"s); it != settings.end()) {
+        if (it->second.AsString() == "dijkstra"s) {
+            engine = RouterEngine::Dijkstra;
+        }
+    }
+
     return {
         settings.at("bus_wait_time"s).AsDouble(),
         settings.at("bus_velocity"s).AsDouble(),
+        engine,
     };
 }
 
@@ -83,26 +355,305 @@ void ParseBaseRequests(TransportCatalogue& catalogue, const json::Document& docu
     }
 }
 
+json::Document ParseBaseRequests(TransportCatalogue& catalogue, std::istream& input) {
+    // Конвейер: парсер складывает готовые остановки в ограниченную очередь,
+    // поток-потребитель наполняет каталог. Единственный потребитель
+    // сохраняет порядок добавления — от него зависят номера остановок.
+    BoundedStopQueue queue(1024);
+    thread consumer([&] {
+        BoundedStopQueue::Item item;
+        while (queue.Pop(item)) {
+            catalogue.AddStop({item.name, item.coordinates});
+        }
+    });
+
+    BaseRequestsHandler handler(catalogue, [&](string name, geo::Coordinates coordinates) {
+        queue.Push({move(name), coordinates});
+    });
+
+    try {
+        json::Load(input, handler);
+    } catch (...) {
+        queue.Close();
+        consumer.join();
+        throw;
+    }
+    queue.Close();
+    consumer.join();
+
+    handler.ApplyDeferredRequests();
+    return handler.ReleaseDocument();
+}
+
+void ParseUpdateRequests(const TransportCatalogue& base, const json::Document& document,
+                         TransportCatalogue& updated) {
+    unordered_set<string_view> removed_stops;
+    unordered_set<string_view> removed_buses;
+    unordered_map<string_view, const Node*> stop_updates;
+    unordered_map<string_view, const Node*> bus_updates;
+    vector<const Node*> new_stops;
+    vector<const Node*> new_buses;
+
+    if (const auto it = document.GetRoot().AsDict().find("update_requests"s);
+            it != document.GetRoot().AsDict().end()) {
+        for (const auto& req : it->second.AsArray()) {
+            const auto& dict = req.AsDict();
+            const auto& type = dict.at("type"s).AsString();
+            const string_view name = dict.at("name"s).AsString();
+            const bool remove = dict.count("action"s) > 0 &&
+                                dict.at("action"s).AsString() == "remove"s;
+
+            if (type == "Stop"s) {
+                if (remove) {
+                    removed_stops.insert(name);
+                } else if (base.HasStop(name)) {
+                    stop_updates.emplace(name, &req);
+                } else {
+                    new_stops.push_back(&req);
+                }
+            } else if (type == "Bus"s) {
+                if (remove) {
+                    removed_buses.insert(name);
+                } else if (base.FindBus(name) != nullptr) {
+                    bus_updates.emplace(name, &req);
+                } else {
+                    new_buses.push_back(&req);
+                }
+            }
+        }
+    }
+
+    // Остановки переигрываются в исходном порядке (новые — в конец), чтобы
+    // нумерация вершин графа сдвигалась только при реальных изменениях.
+    for (const auto& stop : base.GetStopsRange()) {
+        if (removed_stops.count(stop.name) > 0) {
+            continue;
+        }
+        if (const auto it = stop_updates.find(stop.name); it != stop_updates.end()) {
+            const auto& dict = it->second->AsDict();
+            updated.AddStop({dict.at("name"s).AsString(), {
+                dict.at("latitude"s).AsDouble(),
+                dict.at("longitude"s).AsDouble()
+            }});
+        } else {
+            updated.AddStop({stop.name, stop.coordinates});
+        }
+    }
+    for (const Node* req : new_stops) {
+        const auto& dict = req->AsDict();
+        updated.AddStop({dict.at("name"s).AsString(), {
+            dict.at("latitude"s).AsDouble(),
+            dict.at("longitude"s).AsDouble()
+        }});
+    }
+
+    // Старые дистанции между выжившими остановками, поверх — дистанции дельты.
+    for (const auto& [stops_pair, distance] : base.GetStopsDistanceRange()) {
+        if (removed_stops.count(stops_pair.first->name) == 0 &&
+                removed_stops.count(stops_pair.second->name) == 0) {
+            updated.SetDistance(updated.FindStop(stops_pair.first->name),
+                                updated.FindStop(stops_pair.second->name), distance);
+        }
+    }
+    for (const auto& [name, req] : stop_updates) {
+        details::ParseInputDistanceRequest(updated, *req);
+    }
+    for (const Node* req : new_stops) {
+        details::ParseInputDistanceRequest(updated, *req);
+    }
+
+    for (const auto& bus : base.GetBusesRange()) {
+        if (removed_buses.count(bus.name) > 0) {
+            continue;
+        }
+        if (const auto it = bus_updates.find(bus.name); it != bus_updates.end()) {
+            details::ParseInputBusRequest(updated, *it->second);
+            continue;
+        }
+
+        vector<StopPtr> stops;
+        stops.reserve(bus.stops.size());
+        for (const StopPtr stop : bus.stops) {
+            if (removed_stops.count(stop->name) == 0) {
+                stops.push_back(&updated.FindStop(stop->name));
+            }
+        }
+        updated.AddBus({bus.name, bus.is_roundtrip, move(stops)});
+    }
+    for (const Node* req : new_buses) {
+        details::ParseInputBusRequest(updated, *req);
+    }
+}
+
 void ParseStatRequests(const RequestHandler& req_handler, const Document& document, ostream& out) {
     Array responses;
     for (const auto& req : document.GetRoot().AsDict().at("stat_requests"s).AsArray()) {
-        const auto type = req.AsDict().at("type"s).AsString();
-        if (type == "Stop"s) {
-            responses.push_back(details::ParseOutputStopRequest(req_handler, req));
-        } else if (type == "Bus"s) {
-            responses.push_back(details::ParseOutputBusRequest(req_handler, req));
-        } else if (type == "Map"s) {
-            responses.push_back(details::ParseOutputMapRequest(req_handler, req));
-        } else if (type == "Route"s) {
-            responses.push_back(details::ParseOutputRouteRequest(req_handler, req));
+        if (auto response = details::HandleStatRequest(req_handler, req)) {
+            responses.push_back(move(*response));
         }
     }
 
     Print(json::Document{{responses}}, out);
 }
 
+void ParseStatRequests(std::istream& input, std::ostream& out, const RequestHandlerFactory& make_handler) {
+    char c;
+    if (!(input >> c) || c != '{') {
+        throw ParsingError("'{' is expected at the start of the document"s);
+    }
+
+    Dict settings;
+    const RequestHandler* req_handler = nullptr;
+    bool handler_requested = false;
+
+    while (input >> c && c != '}') {
+        if (c == ',') {
+            continue;
+        }
+        if (c != '"') {
+            throw ParsingError(R"('"' is expected but ')"s + c + "' has been found"s);
+        }
+        input.putback(c);
+        auto key = json::Load(input).GetRoot().AsString();
+        if (!(input >> c) || c != ':') {
+            throw ParsingError(": is expected but '"s + c + "' has been found"s);
+        }
+
+        if (key != "stat_requests"s) {
+            settings.emplace(move(key), json::Load(input).GetRoot());
+            continue;
+        }
+
+        if (!(input >> c) || c != '[') {
+            throw ParsingError("stat_requests is expected to be an array"s);
+        }
+
+        // Однопроходный разбор требует, чтобы настройки базы были прочитаны
+        // до первого запроса: ключи JSON-объекта не упорядочены, но здесь
+        // порядок — условие потокового режима (см. комментарий в json_reader.h).
+        // Лучше внятная ошибка, чем out_of_range из недр фабрики.
+        if (settings.count("serialization_settings"s) == 0) {
+            throw ParsingError(
+                "'serialization_settings' must precede 'stat_requests' in streaming mode"s);
+        }
+
+        // К началу stat_requests секции настроек уже разобраны — открываем базу.
+        req_handler = make_handler(json::Document{Node{settings}});
+        handler_requested = true;
+
+        const size_t thread_count =
+            max<size_t>(1, ParseSerializationSettings(json::Document{Node{settings}}).thread_count);
+
+        // Запросы читаются пачками: пачка обрабатывается пулом потоков
+        // (RequestHandler после десериализации только читается), ответы
+        // выводятся в исходном порядке. Память ограничена размером пачки.
+        constexpr size_t BATCH_SIZE = 1024;
+        vector<Node> batch;
+        batch.reserve(BATCH_SIZE);
+
+        bool first = true;
+        auto flush_batch = [&] {
+            if (batch.empty()) {
+                return;
+            }
+            vector<optional<Node>> responses(batch.size());
+
+            if (thread_count < 2 || batch.size() < 2) {
+                for (size_t i = 0; i < batch.size(); ++i) {
+                    responses[i] = details::HandleStatRequest(*req_handler, batch[i]);
+                }
+            } else {
+                atomic<size_t> next_request{0};
+                exception_ptr worker_error;
+                mutex error_mutex;
+
+                auto worker = [&] {
+                    try {
+                        for (size_t i = next_request++; i < batch.size(); i = next_request++) {
+                            responses[i] = details::HandleStatRequest(*req_handler, batch[i]);
+                        }
+                    } catch (...) {
+                        lock_guard<mutex> guard(error_mutex);
+                        worker_error = current_exception();
+                    }
+                };
+
+                vector<thread> workers;
+                workers.reserve(thread_count - 1);
+                for (size_t i = 1; i < min(thread_count, batch.size()); ++i) {
+                    workers.emplace_back(worker);
+                }
+                worker();
+                for (auto& w : workers) {
+                    w.join();
+                }
+                if (worker_error) {
+                    rethrow_exception(worker_error);
+                }
+            }
+
+            for (auto& response : responses) {
+                if (response) {
+                    if (!first) {
+                        out << ",\n"sv;
+                    }
+                    first = false;
+                    Print(*response, out);
+                }
+            }
+            batch.clear();
+        };
+
+        if (req_handler) {
+            out << "[\n"sv;
+        }
+        while (input >> c && c != ']') {
+            if (c == ',') {
+                continue;
+            }
+            input.putback(c);
+            auto request = json::Load(input).GetRoot();
+            if (!req_handler) {
+                continue;
+            }
+            batch.push_back(move(request));
+            if (batch.size() == BATCH_SIZE) {
+                flush_batch();
+            }
+        }
+        if (!input) {
+            throw ParsingError("stat_requests parsing error"s);
+        }
+        if (req_handler) {
+            flush_batch();
+            out << "\n]"sv;
+        }
+    }
+    if (!input) {
+        throw ParsingError("Document parsing error"s);
+    }
+    if (!handler_requested) {
+        // Документ без stat_requests: базу всё равно открывать не для чего.
+        make_handler(json::Document{Node{settings}});
+    }
+}
+
 namespace details {
 
+optional<json::Node> HandleStatRequest(const RequestHandler& req_handler, const json::Node& req) {
+    const auto& type = req.AsDict().at("type"s).AsString();
+    if (type == "Stop"s) {
+        return ParseOutputStopRequest(req_handler, req);
+    } else if (type == "Bus"s) {
+        return ParseOutputBusRequest(req_handler, req);
+    } else if (type == "Map"s) {
+        return ParseOutputMapRequest(req_handler, req);
+    } else if (type == "Route"s) {
+        return ParseOutputRouteRequest(req_handler, req);
+    }
+    return nullopt;
+}
+
 svg::Point ParsePoint(const json::Array &point) {
     return {point[0].AsDouble(), point[1].AsDouble()};
 }
@@ -150,15 +701,16 @@ void ParseInputBusRequest(TransportCatalogue& catalogue, const Node& request) {
 }
 
 Node ParseOutputStopRequest(const RequestHandler& req_handler, const Node& req) {
-    if (const auto* buses = req_handler.GetBusesByStop(req.AsDict().at("name"s).AsString())) {
-        set<string> bus_names;
+    if (const auto buses = req_handler.GetBusesByStop(req.AsDict().at("name"s).AsString())) {
+        // Список уже отсортирован по имени индексом каталога.
+        Array bus_names;
         for (const auto* bus : *buses) {
-            bus_names.insert(bus->name);
+            bus_names.push_back(string(bus->name));
         }
         return Builder{}
             .StartDict()
                 .Key("request_id"s).Value(req.AsDict().at("id"s).AsInt())
-                .Key("buses"s).Value(Array{bus_names.begin(), bus_names.end()})
+                .Key("buses"s).Value(move(bus_names))
             .EndDict()
             .Build();
     } else {
@@ -193,13 +745,10 @@ Node ParseOutputBusRequest(const RequestHandler& req_handler, const Node& req) {
 }
 
 Node ParseOutputMapRequest(const RequestHandler& req_handler, const Node& req) {
-    ostringstream out;
-    req_handler.RenderMap().Render(out);
-
     return Builder{}
         .StartDict()
             .Key("request_id"s).Value(req.AsDict().at("id"s).AsInt())
-            .Key("map"s).Value(out.str())
+            .Key("map"s).Value(req_handler.RenderMapString())
         .EndDict()
         .Build();
 }
@@ -209,7 +758,7 @@ Node ParseOutputRouteRequest(const RequestHandler& req_handler, const Node& req)
     const auto to = req.AsDict().at("to"s).AsString();
 
     if (auto result = req_handler.BuildRoute(from, to)) {
-        const auto [total_time, route_items] = *result;
+        const auto& [total_time, route_items] = *result;
 
         Builder itemsBuilder;
         auto arrayBuilder = itemsBuilder.StartArray();
@@ -218,7 +767,7 @@ Node ParseOutputRouteRequest(const RequestHandler& req_handler, const Node& req)
                 arrayBuilder.Value(Builder{}
                     .StartDict()
                         .Key("type"s).Value("Wait"s)
-                        .Key("stop_name"s).Value(item.stop_name)
+                        .Key("stop_name"s).Value(string(item.stop_name))
                         .Key("time"s).Value(item.time)
                     .EndDict()
                     .Build()
@@ -228,7 +777,7 @@ Node ParseOutputRouteRequest(const RequestHandler& req_handler, const Node& req)
                 arrayBuilder.Value(Builder{}
                     .StartDict()
                         .Key("type"s).Value("Bus"s)
-                        .Key("bus"s).Value(item.bus_name)
+                        .Key("bus"s).Value(string(item.bus_name))
                         .Key("span_count"s).Value(item.span_count)
                         .Key("time"s).Value(item.time)
                     .EndDict()
@@ -5,7 +5,9 @@
 #include "json.h"
 #include "transport_router.h"
 
+#include <functional>
 #include <iostream>
+#include <optional>
 #include <unordered_set>
 
 /*
@@ -23,8 +25,49 @@ transport_catalogue::RoutingSettings ParseRoutingSettings(const json::Document&
 
 void ParseBaseRequests(TransportCatalogue& catalogue, const json::Document& document);
 
+/*
+ * Потоковый вариант для многогигабайтных входов: документ читается SAX-парсером
+ * (json::Load с обработчиком событий), запросы base_requests применяются по
+ * мере разбора и в DOM не попадают, так что пиковая память ограничена одним
+ * запросом плюс отложенными ссылками на ещё не объявленные остановки.
+ * Остальные секции верхнего уровня собираются в возвращаемый документ.
+ */
+json::Document ParseBaseRequests(TransportCatalogue& catalogue, std::istream& input);
+
+/*
+ * Режим update_base: собирает в updated копию каталога base с применённой
+ * дельтой из секции update_requests. Элементы дельты повторяют формат
+ * base_requests (Stop/Bus объявляются заново — это замена), дополнительно
+ * поддерживается "action": "remove" — удаление остановки или маршрута по
+ * имени. Остановки, выбывшие из базы, выбрасываются и из старых маршрутов.
+ * Каталог хранит данные append-only (на остановки и маршруты всюду розданы
+ * указатели), поэтому удаление реализовано пересборкой, а не правкой на месте.
+ */
+void ParseUpdateRequests(const TransportCatalogue& base, const json::Document& document,
+                         TransportCatalogue& updated);
+
 void ParseStatRequests(const RequestHandler& request_handler, const json::Document& document, std::ostream& out);
 
+/*
+ * Потоковый вариант process_requests: документ читается за один проход,
+ * секции до stat_requests собираются в DOM и передаются фабрике, которая
+ * по ним открывает базу и возвращает обработчик (nullptr — базы нет, ответы
+ * не выводятся; элементы при этом всё равно дочитываются). Однопроходность
+ * накладывает требование к порядку ключей: serialization_settings обязана
+ * идти раньше stat_requests, иначе бросается ParsingError (DOM-вариант
+ * порядка не требует). Каждый элемент
+ * stat_requests обрабатывается и сериализуется в out сразу после разбора,
+ * поэтому память не зависит от числа запросов, а первый ответ появляется
+ * до конца чтения входа. Возвращённый обработчик должен жить до конца вызова.
+ *
+ * При serialization_settings.thread_count > 1 запросы обрабатываются пачками
+ * пулом потоков (обработчик после десериализации только читается), порядок
+ * ответов при этом сохраняется.
+ */
+using RequestHandlerFactory = std::function<const RequestHandler*(const json::Document& settings)>;
+
+void ParseStatRequests(std::istream& input, std::ostream& out, const RequestHandlerFactory& make_handler);
+
 namespace details {
 
 svg::Point ParsePoint(const json::Array& point);
@@ -35,6 +78,10 @@ void ParseInputDistanceRequest(TransportCatalogue& catalogue, const json::Node&
 
 void ParseInputBusRequest(TransportCatalogue& catalogue, const json::Node& request);
 
+// Диспетчеризация одного stat-запроса по полю type; запросы неизвестного
+// типа, как и раньше, молча пропускаются (nullopt).
+std::optional<json::Node> HandleStatRequest(const RequestHandler& request_handler, const json::Node& request);
+
 json::Node ParseOutputStopRequest(const RequestHandler& request_handler, const json::Node& request);
 
 json::Node ParseOutputBusRequest(const RequestHandler& request_handler, const json::Node& request);
@@ -0,0 +1,57 @@
+#include "json.h"
+
+#include <cassert>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+json::Node LoadNode(const string& text) {
+    istringstream input(text);
+    return json::Load(input).GetRoot();
+}
+
+// Скалярный документ с ведущими пробелами, упирающийся в конец потока:
+// регрессия на лексер — при дочитывании хвост буфера сдвигается в начало,
+// и конец токена не должен захватывать байты старой раскладки
+// (" 123" разбирался как 1233, " null" — как литерал "nulll").
+void TestScalarDocumentAtEof() {
+    assert(LoadNode(" 123"s).AsInt() == 123);
+    assert(LoadNode(" -7"s).AsInt() == -7);
+    assert(LoadNode(" 1.5"s).AsDouble() == 1.5);
+    assert(LoadNode(" 2e3"s).AsDouble() == 2000.0);
+    assert(LoadNode(" null"s).IsNull());
+    assert(LoadNode(" true"s).AsBool());
+    assert(!LoadNode("  false"s).AsBool());
+    assert(LoadNode(" \"abc\""s).AsString() == "abc"s);
+}
+
+// Документ с вложенными значениями разбирается как прежде.
+void TestCompositeDocument() {
+    const auto node = LoadNode(R"({"a": 1, "b": [true, null, "x\ny"], "c": {"d": 2.5}})"s);
+    const auto& dict = node.AsDict();
+    assert(dict.at("a"s).AsInt() == 1);
+    assert(dict.at("b"s).AsArray().at(2).AsString() == "x\ny"s);
+    assert(dict.at("c"s).AsDict().at("d"s).AsDouble() == 2.5);
+}
+
+// После Load поток стоит ровно за распарсенным значением: json_reader
+// чередует Load с прямым чтением из того же потока.
+void TestStreamPositionAfterLoad() {
+    istringstream input("42,\"next\""s);
+    assert(json::Load(input).GetRoot().AsInt() == 42);
+    char c;
+    assert(input >> c && c == ',');
+    assert(json::Load(input).GetRoot().AsString() == "next"s);
+}
+
+}  // namespace
+
+int main() {
+    TestScalarDocumentAtEof();
+    TestCompositeDocument();
+    TestStreamPositionAfterLoad();
+    return 0;
+}
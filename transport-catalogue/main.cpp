@@ -7,8 +7,11 @@
 #include "router.h"
 #include "serialization.h"
 
+#include <cstdio>
 #include <fstream>
+#include <future>
 #include <iostream>
+#include <optional>
 #include <string_view>
 
 // #include "tests.h"
@@ -18,33 +21,122 @@ using namespace transport_catalogue;
 using namespace renderer;
 
 void PrintUsage(std::ostream& stream = std::cerr) {
-    stream << "Usage: transport_catalogue [make_base|process_requests]\n"sv;
+    stream << "Usage: transport_catalogue [make_base|process_requests|update_base]\n"sv;
 }
 
-void MakeBase(const json::Document& document) {
+// Завершает атомарную подмену базы: проверяет состояние потока после записи
+// и результат rename. При любой ошибке (диск переполнен, нет прав) прежняя
+// база остаётся нетронутой, а недописанный временный файл удаляется —
+// иначе усечённая база затёрла бы рабочую.
+int CommitDatabase(ofstream&& ofs, const string& tmp_file, const string& db_file) {
+    ofs.close();
+    if (!ofs) {
+        cerr << "Failed to write "sv << tmp_file << ", database "sv << db_file
+             << " is left unchanged\n"sv;
+        remove(tmp_file.c_str());
+        return 1;
+    }
+    if (rename(tmp_file.c_str(), db_file.c_str()) != 0) {
+        cerr << "Failed to rename "sv << tmp_file << " to "sv << db_file
+             << ", database is left unchanged\n"sv;
+        remove(tmp_file.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+int MakeBase(std::istream& input) {
     TransportCatalogue transport_catalogue;
-    ParseBaseRequests(transport_catalogue, document);
+    // base_requests потребляются потоково, в document остаются только
+    // компактные секции настроек.
+    const auto document = ParseBaseRequests(transport_catalogue, input);
+    transport_catalogue.BuildBusStats();
+
+    // Матрица роутера — самая дорогая часть make_base; она достраивается в
+    // фоне, пока основной поток готовит рендерер, сериализует независимые
+    // от роутера секции и рендерит карту (см. конвейерный Serialize).
+    auto transport_router = async(launch::async, [&] {
+        return TransportRouter(ParseRoutingSettings(document), transport_catalogue);
+    });
 
     MapRenderer map_renderer(ParseRenderSettings(document));
 
-    TransportRouter transport_router(ParseRoutingSettings(document), transport_catalogue);
-
     const auto& serialization_settings = ParseSerializationSettings(document);
-    ofstream ofs(serialization_settings.file, ios::binary);
-    transport_catalogue_serialize::Serialize(transport_catalogue, map_renderer, transport_router, ofs);
+
+    // База пишется во временный файл и подменяется атомарным rename:
+    // параллельные process_requests, держащие прежнюю базу через mmap,
+    // продолжают читать старый инод, а новые процессы открывают уже
+    // целиком записанный файл.
+    const string tmp_file = serialization_settings.file + ".tmp"s;
+    ofstream ofs(tmp_file, ios::binary);
+    transport_catalogue_serialize::Serialize(transport_catalogue, map_renderer,
+                                             std::move(transport_router), ofs,
+                                             serialization_settings.compact_router);
+    return CommitDatabase(std::move(ofs), tmp_file, serialization_settings.file);
 }
 
-void ProcessRequests(const json::Document& document) {
+// Инкрементальное обновление базы: вход — serialization_settings плюс
+// update_requests (формат описан у ParseUpdateRequests). Настройки рендера
+// и маршрутизации берутся из самой базы; если дельта лишь добавила маршруты
+// или сократила дистанции, матрица маршрутизатора ремонтируется точечно
+// вместо полного предрасчёта.
+int UpdateBase(std::istream& input) {
+    const auto document = json::Load(input);
     const auto& serialization_settings = ParseSerializationSettings(document);
-    ifstream ifs(serialization_settings.file, ios::binary);
 
-    if (auto result = transport_catalogue_serialize::Deserialize(ifs)) {
-        auto& [transport_catalogue, map_renderer, transport_router] = *result;
+    auto database = transport_catalogue_serialize::Deserialize(serialization_settings.file);
+    if (!database) {
+        cerr << "Database "sv << serialization_settings.file << " is missing or corrupt\n"sv;
+        return 1;
+    }
 
-        RequestHandler request_handler(transport_catalogue, map_renderer, transport_router);
-        ParseStatRequests(request_handler, document, cout);
+    TransportCatalogue transport_catalogue;
+    ParseUpdateRequests(database->transport_catalogue, document, transport_catalogue);
+    transport_catalogue.BuildBusStats();
+
+    MapRenderer map_renderer(database->map_renderer.GetSetings());
+    optional<TransportRouter> transport_router;
+    transport_router.emplace(database->route_manager.GetSettings(), database->route_manager,
+                             transport_catalogue);
+
+    // Старое отображение можно не закрывать — rename не трогает прежний
+    // инод, — но база уже не нужна, освобождаем память до записи новой.
+    database.reset();
+
+    // Как и в make_base: временный файл плюс атомарный rename, живые
+    // читатели старой базы не видят частично записанного файла.
+    const string tmp_file = serialization_settings.file + ".tmp"s;
+    ofstream ofs(tmp_file, ios::binary);
+    transport_catalogue_serialize::Serialize(transport_catalogue, map_renderer,
+                                             *transport_router, ofs,
+                                             serialization_settings.compact_router);
+    return CommitDatabase(std::move(ofs), tmp_file, serialization_settings.file);
+}
 
-        // request_handler.RenderMap().Render(cout);
+void ProcessRequests(std::istream& input) {
+    optional<transport_catalogue_serialize::DeserializeResult> database;
+    optional<RequestHandler> request_handler;
+
+    // Ответы пишутся в cout по мере чтения stat_requests; база открывается,
+    // как только из потока разобраны serialization_settings.
+    ParseStatRequests(input, cout, [&](const json::Document& settings) -> const RequestHandler* {
+        const auto& serialization_settings = ParseSerializationSettings(settings);
+
+        auto result = transport_catalogue_serialize::Deserialize(serialization_settings.file);
+        if (!result) {
+            return nullptr;
+        }
+        database.emplace(move(*result));
+
+        request_handler.emplace(database->transport_catalogue, database->map_renderer,
+                                database->route_manager);
+        return &*request_handler;
+    });
+
+    // В сборке с TRANSPORT_CATALOGUE_LATENCY_STATS — сводка задержек по
+    // типам запросов; иначе вызов пустой.
+    if (request_handler) {
+        request_handler->DumpLatencyStats(cerr);
     }
 }
 
@@ -56,13 +148,14 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    const auto& document = json::Load(cin);
     const std::string_view mode(argv[1]);
 
     if (mode == "make_base"sv) {
-        MakeBase(document);
+        return MakeBase(cin);
+    } else if (mode == "update_base"sv) {
+        return UpdateBase(cin);
     } else if (mode == "process_requests"sv) {
-        ProcessRequests(document);
+        ProcessRequests(cin);
     } else {
         PrintUsage();
         return 1;
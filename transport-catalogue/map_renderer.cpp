@@ -24,12 +24,30 @@ const RenderSettings& MapRenderer::GetSetings() const {
     return settings_;
 }
 
+void MapRenderer::SetRenderedMap(string rendered_map) {
+    rendered_map_ = move(rendered_map);
+}
+
+const optional<string>& MapRenderer::GetRenderedMap() const {
+    return rendered_map_;
+}
+
 Polyline MapRenderer::RenderRouteLine(BusPtr bus, const Color& color, const SphereProjector& projector) const {
-    const auto stops = MakeRoute(bus);
-    Polyline route;
+    const RouteView stops(*bus);
 
+    // Координаты звеньев проецируются одним пакетным вызовом.
+    vector<geo::Coordinates> coords;
+    coords.reserve(stops.size());
     for (const auto* stop : stops) {
-        route.AddPoint(projector(stop->coordinates));
+        coords.push_back(stop->coordinates);
+    }
+
+    vector<Point> points(coords.size());
+    projector.Project(coords.data(), points.data(), coords.size());
+
+    Polyline route;
+    for (const auto& point : points) {
+        route.AddPoint(point);
     }
 
     return route
@@ -40,7 +58,7 @@ Polyline MapRenderer::RenderRouteLine(BusPtr bus, const Color& color, const Sphe
         .SetStrokeWidth(settings_.line_width);
 }
 
-void MapRenderer::RenderRouteName(const Point& position, const Color& color, const string& name, vector<Text>& out_texts) const {
+void MapRenderer::RenderRouteName(const Point& position, const Color& color, string_view name, vector<Text>& out_texts) const {
     out_texts.push_back(Text()
         .SetFillColor(settings_.underlayer_color)
         .SetStrokeColor(settings_.underlayer_color)
@@ -52,7 +70,7 @@ void MapRenderer::RenderRouteName(const Point& position, const Color& color, con
         .SetFontSize(settings_.bus_label_font_size)
         .SetFontFamily("Verdana"s)
         .SetFontWeight("bold"s)
-        .SetData(name)
+        .SetData(string(name))
     );
 
     out_texts.push_back(Text()
@@ -62,11 +80,11 @@ void MapRenderer::RenderRouteName(const Point& position, const Color& color, con
         .SetFontSize(settings_.bus_label_font_size)
         .SetFontFamily("Verdana"s)
         .SetFontWeight("bold"s)
-        .SetData(name)
+        .SetData(string(name))
     );
 }
 
-void MapRenderer::RenderStopName(const Point& position, const string& name, Document& document) const {
+void MapRenderer::RenderStopName(const Point& position, string_view name, Document& document) const {
     document.Add(Text()
         .SetFillColor(settings_.underlayer_color)
         .SetStrokeColor(settings_.underlayer_color)
@@ -77,7 +95,7 @@ void MapRenderer::RenderStopName(const Point& position, const string& name, Docu
         .SetOffset(settings_.stop_label_offset)
         .SetFontSize(settings_.stop_label_font_size)
         .SetFontFamily("Verdana"s)
-        .SetData(name)
+        .SetData(string(name))
     );
 
     document.Add(Text()
@@ -86,7 +104,7 @@ void MapRenderer::RenderStopName(const Point& position, const string& name, Docu
         .SetOffset(settings_.stop_label_offset)
         .SetFontSize(settings_.stop_label_font_size)
         .SetFontFamily("Verdana"s)
-        .SetData(name)
+        .SetData(string(name))
     );
 }
 
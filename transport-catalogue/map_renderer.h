@@ -3,6 +3,10 @@
 #include "domain.h"
 #include "geo.h"
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 #include <algorithm>
 #include <cstdlib>
 #include <iostream>
@@ -11,6 +15,9 @@
 #include <vector>
 #include <numeric>
 #include <set>
+#include <string>
+#include <string_view>
+#include <thread>
 
 namespace renderer {
 
@@ -100,6 +107,34 @@ public:
         };
     }
 
+    // Пакетная проекция: out[i] = (*this)(coords[i]). На AVX2 обе координаты
+    // двух точек обрабатываются одной 256-битной операцией; результат
+    // бит-в-бит совпадает со скалярным operator() — порядок операций
+    // сохранён (вычитание, умножение, сложение, без FMA).
+    void Project(const geo::Coordinates* coords, svg::Point* out, size_t count) const {
+        size_t i = 0;
+#ifdef __AVX2__
+        // Coordinates и Point — пары double, поэтому две точки — это ровно
+        // один вектор [lat0, lng0, lat1, lng1]. Скалярные выражения
+        // (lng - min_lon) * zoom и (max_lat - lat) * zoom ≡ (lat - max_lat) * (-zoom):
+        // смена знака множителя в IEEE точна, что и позволяет обойтись
+        // одним вычитанием на обе дорожки.
+        const __m256d sub = _mm256_setr_pd(max_lat_, min_lon_, max_lat_, min_lon_);
+        const __m256d mul = _mm256_setr_pd(-zoom_coeff_, zoom_coeff_, -zoom_coeff_, zoom_coeff_);
+        const __m256d add = _mm256_set1_pd(padding_);
+
+        for (; i + 2 <= count; i += 2) {
+            const __m256d latlng = _mm256_loadu_pd(&coords[i].lat);
+            const __m256d yx = _mm256_add_pd(_mm256_mul_pd(_mm256_sub_pd(latlng, sub), mul), add);
+            // [y0, x0, y1, x1] -> [x0, y0, x1, y1]
+            _mm256_storeu_pd(&out[i].x, _mm256_permute_pd(yx, 0b0101));
+        }
+#endif
+        for (; i < count; ++i) {
+            out[i] = (*this)(coords[i]);
+        }
+    }
+
 private:
     double padding_;
     double min_lon_ = 0;
@@ -113,23 +148,40 @@ public:
 
     const RenderSettings& GetSetings() const;
 
+    // Карта полностью определяется базой, поэтому process_requests получает
+    // её готовой строкой из сериализованной базы и не рендерит заново.
+    void SetRenderedMap(std::string rendered_map);
+
+    const std::optional<std::string>& GetRenderedMap() const;
+
     template<typename BusIterator>
     svg::Document RenderMap(BusIterator first, BusIterator last) const;
 
 private:
+    // Карта собирается из четырёх независимых слоёв (линии маршрутов, их
+    // названия, кружки остановок, подписи остановок); RenderMap рендерит их
+    // параллельно и склеивает в z-порядке. positions — заранее
+    // спроецированные координаты остановок в порядке обхода [first, last).
+    template<typename BusIterator>
+    void RenderRouteLines(BusIterator first, BusIterator last, const SphereProjector& projector, svg::Document& document) const;
+
     template<typename BusIterator>
-    void RenderRoutes(BusIterator first, BusIterator last, const SphereProjector& projector, svg::Document& document) const;
+    void RenderRouteNames(BusIterator first, BusIterator last, const SphereProjector& projector, svg::Document& document) const;
 
     template<typename StopIterator>
-    void RenderStops(StopIterator first, StopIterator last, const SphereProjector& projector, svg::Document& document) const;
+    void RenderStopCircles(StopIterator first, StopIterator last, const std::vector<svg::Point>& positions, svg::Document& document) const;
+
+    template<typename StopIterator>
+    void RenderStopNames(StopIterator first, StopIterator last, const std::vector<svg::Point>& positions, svg::Document& document) const;
 
     svg::Polyline RenderRouteLine(transport_catalogue::BusPtr bus, const svg::Color& color, const SphereProjector& projector) const;
 
-    void RenderRouteName(const svg::Point& position, const svg::Color& color, const std::string& name, std::vector<svg::Text>& out_texts) const;
+    void RenderRouteName(const svg::Point& position, const svg::Color& color, std::string_view name, std::vector<svg::Text>& out_texts) const;
 
-    void RenderStopName(const svg::Point& position, const std::string& name, svg::Document& document) const;
+    void RenderStopName(const svg::Point& position, std::string_view name, svg::Document& document) const;
 
     const RenderSettings settings_;
+    std::optional<std::string> rendered_map_;
 };
 
 template<typename BusIterator>
@@ -156,14 +208,50 @@ svg::Document MapRenderer::RenderMap(BusIterator first, BusIterator last) const
         settings_.height, settings_.padding
     );
 
+    // Все позиции остановок проецируются одним пакетным вызовом.
+    vector<svg::Point> positions(points.size());
+    projector.Project(points.data(), positions.data(), points.size());
+
+    // Слои независимы при общем проекторе: три рендерятся в рабочих
+    // потоках, четвёртый — в текущем, затем буферы склеиваются в z-порядке
+    // (линии, названия маршрутов, кружки, подписи остановок).
+    svg::Document lines;
+    svg::Document route_names;
+    svg::Document circles;
+    svg::Document stop_names;
+
+    thread lines_worker([&] { RenderRouteLines(first, last, projector, lines); });
+    thread names_worker([&] { RenderRouteNames(first, last, projector, route_names); });
+    thread circles_worker([&] { RenderStopCircles(stops.begin(), stops.end(), positions, circles); });
+    RenderStopNames(stops.begin(), stops.end(), positions, stop_names);
+    lines_worker.join();
+    names_worker.join();
+    circles_worker.join();
+
     svg::Document document;
-    RenderRoutes(first, last, projector, document);
-    RenderStops(stops.begin(), stops.end(), projector, document);
+    document.Append(move(lines));
+    document.Append(move(route_names));
+    document.Append(move(circles));
+    document.Append(move(stop_names));
     return document;
 }
 
 template<typename BusIterator>
-void MapRenderer::RenderRoutes(BusIterator first, BusIterator last, const SphereProjector& projector, svg::Document& document) const {
+void MapRenderer::RenderRouteLines(BusIterator first, BusIterator last, const SphereProjector& projector, svg::Document& document) const {
+    using namespace std;
+
+    document.Reserve(distance(first, last));
+
+    size_t index = 0;
+    size_t nums = settings_.color_palette.size();
+    for (auto it = first; it != last; ++it) {
+        const auto& color = settings_.color_palette[index++ % nums];
+        document.Add(RenderRouteLine(*it, color, projector));
+    }
+}
+
+template<typename BusIterator>
+void MapRenderer::RenderRouteNames(BusIterator first, BusIterator last, const SphereProjector& projector, svg::Document& document) const {
     using namespace svg;
     using namespace std;
 
@@ -175,35 +263,45 @@ void MapRenderer::RenderRoutes(BusIterator first, BusIterator last, const Sphere
         const auto& color = settings_.color_palette[index++ % nums];
         transport_catalogue::BusPtr bus = *it;
 
-        document.Add(RenderRouteLine(bus, color, projector));
-
         RenderRouteName(projector(bus->stops.front()->coordinates), color, bus->name, route_names);
         if (!bus->is_roundtrip && bus->stops.front() != bus->stops.back()) {
             RenderRouteName(projector(bus->stops.back()->coordinates), color, bus->name, route_names);
         }
     }
 
-    for (const auto& name : route_names) {
-        document.Add(name);
+    document.Reserve(route_names.size());
+    for (auto& name : route_names) {
+        document.Add(std::move(name));
     }
 }
 
 template<typename StopIterator>
-void MapRenderer::RenderStops(StopIterator first, StopIterator last, const SphereProjector& projector, svg::Document& document) const {
+void MapRenderer::RenderStopCircles(StopIterator first, StopIterator last, const std::vector<svg::Point>& positions, svg::Document& document) const {
     using namespace svg;
     using namespace std;
 
-    for (auto it = first; it != last; ++it) {
-        transport_catalogue::StopPtr stop = *it;
-        document.Add(Circle()
-            .SetCenter(projector(stop->coordinates))
+    document.Reserve(positions.size());
+
+    size_t index = 0;
+    for (auto it = first; it != last; ++it, ++index) {
+        document.Emplace<Circle>()
+            .SetCenter(positions[index])
             .SetRadius(settings_.stop_radius)
-            .SetFillColor("white"s));
+            .SetFillColor("white"s);
     }
+}
 
-    for (auto it = first; it != last; ++it) {
+template<typename StopIterator>
+void MapRenderer::RenderStopNames(StopIterator first, StopIterator last, const std::vector<svg::Point>& positions, svg::Document& document) const {
+    using namespace std;
+
+    // Подпись — два текста (подложка и сам текст).
+    document.Reserve(2 * positions.size());
+
+    size_t index = 0;
+    for (auto it = first; it != last; ++it, ++index) {
         transport_catalogue::StopPtr stop = *it;
-        RenderStopName(projector(stop->coordinates), stop->name, document);
+        RenderStopName(positions[index], stop->name, document);
     }
 }
 
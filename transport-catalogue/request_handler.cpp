@@ -3,6 +3,7 @@
 #include "map_renderer.h"
 #include "svg.h"
 
+#include <sstream>
 #include <utility>
 #include <vector>
 
@@ -11,6 +12,53 @@ namespace transport_catalogue {
 using namespace std;
 using namespace renderer;
 
+#ifdef TRANSPORT_CATALOGUE_LATENCY_STATS
+// Ставит RAII-сэмпл на весь вызов; в сборке без флага разворачивается в ничто.
+#define TC_MEASURE_LATENCY(histogram) const details::LatencyTimer latency_sample(histogram)
+
+namespace details {
+
+uint64_t LatencyHistogram::Percentile(double quantile) const {
+    uint64_t total = 0;
+    for (const auto& bucket : buckets_) {
+        total += bucket.load(memory_order_relaxed);
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    const auto target = static_cast<uint64_t>(quantile * static_cast<double>(total));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+        seen += buckets_[bucket].load(memory_order_relaxed);
+        if (seen > target) {
+            // Верхняя граница корзины: значения в ней не превышают 2^(bucket+1)-1 нс.
+            return (uint64_t{2} << bucket) - 1;
+        }
+    }
+    return max_ns_.load(memory_order_relaxed);
+}
+
+void LatencyHistogram::Dump(string_view name, ostream& out) const {
+    uint64_t total = 0;
+    for (const auto& bucket : buckets_) {
+        total += bucket.load(memory_order_relaxed);
+    }
+
+    out << name << ": count " << total;
+    if (total > 0) {
+        out << ", p50 " << Percentile(0.5) / 1000.0 << " us"
+            << ", p99 " << Percentile(0.99) / 1000.0 << " us"
+            << ", max " << max_ns_.load(memory_order_relaxed) / 1000.0 << " us";
+    }
+    out << '\n';
+}
+
+}  // namespace details
+#else
+#define TC_MEASURE_LATENCY(histogram)
+#endif  // TRANSPORT_CATALOGUE_LATENCY_STATS
+
 RequestHandler::RequestHandler(const TransportCatalogue& db, const MapRenderer& renderer, const TransportRouter& router) :
     db_(db),
     renderer_(renderer),
@@ -18,16 +66,18 @@ RequestHandler::RequestHandler(const TransportCatalogue& db, const MapRenderer&
 }
 
 std::optional<BusStat> RequestHandler::GetBusStat(const std::string_view& bus_name) const {
+    TC_MEASURE_LATENCY(bus_stat_latency_);
     return db_.GetBusStat(bus_name);
 }
 
-const std::unordered_set<BusPtr>* RequestHandler::GetBusesByStop(const std::string_view& stop_name) const {
+std::optional<TransportCatalogue::BusesRange> RequestHandler::GetBusesByStop(const std::string_view& stop_name) const {
+    TC_MEASURE_LATENCY(stop_buses_latency_);
     return db_.GetBusesByStop(stop_name);
 }
 
 svg::Document RequestHandler::RenderMap() const {
     vector<BusPtr> buses;
-    for (const auto& [_, bus] : db_) {
+    for (const auto bus : db_) {
         if (!bus->stops.empty()) {
             buses.push_back(bus);
         }
@@ -36,8 +86,29 @@ svg::Document RequestHandler::RenderMap() const {
     return renderer_.RenderMap(buses.begin(), buses.end());
 }
 
-optional<TransportRouter::RouteResult> RequestHandler::BuildRoute(string_view from, string_view to) const {
+std::string RequestHandler::RenderMapString() const {
+    TC_MEASURE_LATENCY(render_map_latency_);
+    if (const auto& cached = renderer_.GetRenderedMap()) {
+        return *cached;
+    }
+
+    ostringstream out;
+    RenderMap().Render(out);
+    return out.str();
+}
+
+TransportRouter::RouteResultPtr RequestHandler::BuildRoute(string_view from, string_view to) const {
+    TC_MEASURE_LATENCY(build_route_latency_);
     return router_.BuildRoute(db_.FindStop(from), db_.FindStop(to));
 }
 
+#ifdef TRANSPORT_CATALOGUE_LATENCY_STATS
+void RequestHandler::DumpLatencyStats(ostream& out) const {
+    bus_stat_latency_.Dump("Bus"sv, out);
+    stop_buses_latency_.Dump("Stop"sv, out);
+    build_route_latency_.Dump("Route"sv, out);
+    render_map_latency_.Dump("Map"sv, out);
+}
+#endif
+
 } // namespace transport_catalogue {
@@ -7,6 +7,14 @@
 #include <utility>
 #include <optional>
 
+#ifdef TRANSPORT_CATALOGUE_LATENCY_STATS
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string_view>
+#endif
+
 /*
  * Здесь можно было бы разместить код обработчика запросов к базе, содержащего логику, которую не
  * хотелось бы помещать ни в transport_catalogue, ни в json reader.
@@ -23,6 +31,63 @@
 // См. паттерн проектирования Фасад: https://ru.wikipedia.org/wiki/Фасад_(шаблон_проектирования)
 namespace transport_catalogue {
 
+#ifdef TRANSPORT_CATALOGUE_LATENCY_STATS
+namespace details {
+
+/*
+ * Гистограмма задержек с log2-корзинами наносекунд. Запись — инкремент
+ * одного атомарного счётчика, поэтому её можно вести из пула потоков
+ * process_requests без блокировок; p50/p99 восстанавливаются по корзинам
+ * с точностью до их ширины.
+ */
+class LatencyHistogram {
+public:
+    void Record(uint64_t ns) {
+        size_t bucket = 0;
+        while (bucket + 1 < BUCKET_COUNT && (ns >> (bucket + 1)) != 0) {
+            ++bucket;
+        }
+        buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+
+        uint64_t prev_max = max_ns_.load(std::memory_order_relaxed);
+        while (ns > prev_max && !max_ns_.compare_exchange_weak(prev_max, ns)) {
+        }
+    }
+
+    // Одна строка сводки: count, p50, p99, max.
+    void Dump(std::string_view name, std::ostream& out) const;
+
+private:
+    static constexpr size_t BUCKET_COUNT = 64;
+
+    uint64_t Percentile(double quantile) const;
+
+    std::atomic<uint64_t> buckets_[BUCKET_COUNT] = {};
+    std::atomic<uint64_t> max_ns_ = 0;
+};
+
+// RAII-сэмпл: меряет время жизни своей области видимости.
+class LatencyTimer {
+public:
+    explicit LatencyTimer(LatencyHistogram& histogram)
+        : histogram_(histogram)
+        , start_(std::chrono::steady_clock::now()) {
+    }
+
+    ~LatencyTimer() {
+        const auto elapsed = std::chrono::steady_clock::now() - start_;
+        histogram_.Record(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    }
+
+private:
+    LatencyHistogram& histogram_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace details
+#endif  // TRANSPORT_CATALOGUE_LATENCY_STATS
+
 class RequestHandler {
 public:
     // MapRenderer понадобится в следующей части итогового проекта
@@ -31,19 +96,39 @@ public:
     // Возвращает информацию о маршруте (запрос Bus)
     std::optional<BusStat> GetBusStat(const std::string_view& bus_name) const;
 
-    // Возвращает маршруты, проходящие через
-    const std::unordered_set<BusPtr>* GetBusesByStop(const std::string_view& stop_name) const;
+    // Возвращает маршруты, проходящие через остановку (отсортированы по имени)
+    std::optional<TransportCatalogue::BusesRange> GetBusesByStop(const std::string_view& stop_name) const;
 
     // Этот метод будет нужен в следующей части итогового проекта
     svg::Document RenderMap() const;
 
-    std::optional<TransportRouter::RouteResult> BuildRoute(std::string_view from, std::string_view to) const;
+    // SVG карты: берётся из кэша рендерера (process_requests), иначе
+    // рендерится на месте (make_base).
+    std::string RenderMapString() const;
+
+    TransportRouter::RouteResultPtr BuildRoute(std::string_view from, std::string_view to) const;
+
+    // Сводка задержек по типам запросов; без TRANSPORT_CATALOGUE_LATENCY_STATS
+    // сборка не меряет ничего и метод ничего не печатает.
+#ifdef TRANSPORT_CATALOGUE_LATENCY_STATS
+    void DumpLatencyStats(std::ostream& out) const;
+#else
+    void DumpLatencyStats(std::ostream&) const {
+    }
+#endif
 
 private:
     // RequestHandler использует агрегацию объектов "Транспортный Справочник" и "Визуализатор Карты"
     const TransportCatalogue& db_;
     const renderer::MapRenderer& renderer_;
     const TransportRouter& router_;
+
+#ifdef TRANSPORT_CATALOGUE_LATENCY_STATS
+    mutable details::LatencyHistogram bus_stat_latency_;
+    mutable details::LatencyHistogram stop_buses_latency_;
+    mutable details::LatencyHistogram build_route_latency_;
+    mutable details::LatencyHistogram render_map_latency_;
+#endif
 };
 
 } // namespace transport_catalogue
@@ -1,14 +1,20 @@
 #pragma once
 
 #include "graph.h"
-#include "ranges.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstdint>
 #include <iterator>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <queue>
 #include <stdexcept>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -20,16 +26,63 @@ class Router {
 public:
     using Graph = DirectedWeightedGraph<Weight>;
 
-    explicit Router(const Graph& graph);
+    // Сентинели плоского хранилища: вес +inf — маршрута нет, ребро NO_EDGE —
+    // путь начинается прямо в исходной вершине. Weight предполагается
+    // вещественным (в проекте Router используется только с double).
+    static constexpr Weight INFINITE_WEIGHT = std::numeric_limits<Weight>::infinity();
+    static constexpr EdgeId NO_EDGE = std::numeric_limits<EdgeId>::max();
 
-    struct RouteInternalData {
-        Weight weight;
-        std::optional<EdgeId> prev_edge;
+    // Матрица всех пар в виде структуры массивов: два сплошных слоя
+    // vertex_count x vertex_count вместо вложенных векторов optional-ячеек.
+    // Так релаксация идёт линейно по памяти, а сама матрица занимает вдвое
+    // меньше места.
+    struct RoutesInternalData {
+        RoutesInternalData() = default;
+
+        explicit RoutesInternalData(size_t vertex_count)
+            : vertex_count(vertex_count)
+            , weights(vertex_count * vertex_count, INFINITE_WEIGHT)
+            , prev_edges(vertex_count * vertex_count, NO_EDGE) {
+        }
+
+        size_t vertex_count = 0;
+        std::vector<Weight> weights;
+        std::vector<EdgeId> prev_edges;
+    };
+
+    // Невладеющее представление слоёв матрицы — например, отображённых в
+    // память прямо из файла базы. Память должна жить дольше Router.
+    struct RoutesDataView {
+        size_t vertex_count = 0;
+        const Weight* weights = nullptr;
+        const EdgeId* prev_edges = nullptr;
+    };
+
+    // Источник строк матрицы для ленивого режима: строка с исходной вершиной
+    // from читается по требованию (например, из файла базы).
+    struct RowSource {
+        virtual ~RowSource() = default;
+        virtual size_t GetVertexCount() const = 0;
+        virtual void ReadRow(VertexId from, Weight* weights, EdgeId* prev_edges) = 0;
     };
-    using RoutesInternalData = std::vector<std::vector<std::optional<RouteInternalData>>>;
+
+    explicit Router(const Graph& graph);
+
+    // Параллельный предрасчёт: блочный (тайловый) Флойд-Уоршелл, фазы
+    // независимых блоков раскладываются по thread_count потокам. Результат
+    // идентичен последовательному конструктору.
+    Router(const Graph& graph, size_t thread_count);
 
     Router(const Graph& graph, RoutesInternalData routes_data);
 
+    // Читает матрицу через view без копирования (zero-copy поверх mmap).
+    Router(const Graph& graph, RoutesDataView routes_view);
+
+    // Ленивый режим: BuildRoute подгружает из source строку вершины from при
+    // первом обращении, в памяти держится не более max_resident_rows строк
+    // (вытеснение LRU). Вся матрица целиком не материализуется никогда.
+    Router(const Graph& graph, std::unique_ptr<RowSource> row_source, size_t max_resident_rows);
+
     struct RouteInfo {
         Weight weight;
         std::vector<EdgeId> edges;
@@ -37,93 +90,438 @@ public:
 
     std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
 
-    auto GetRoutesRange() const {
-        return ranges::AsRange(routes_internal_data_);
+    // Вариант без аллокаций в устоявшемся режиме: рёбра маршрута дописываются
+    // в переиспользуемый буфер вызывающего, вес — в weight. Возвращает false,
+    // если пути нет (edges при этом очищен).
+    bool BuildRoute(VertexId from, VertexId to, Weight& weight, std::vector<EdgeId>& edges) const;
+
+    const RoutesInternalData& GetRoutesData() const {
+        return data_;
+    }
+
+    // Владеющая копия матрицы независимо от режима хранения: view и ленивый
+    // источник вычитываются построчно. Нужна для инкрементального ремонта
+    // матрицы при update_base.
+    RoutesInternalData MaterializeRoutesData() const {
+        if (!view_.weights && !row_source_) {
+            return data_;
+        }
+
+        const size_t vertex_count = VertexCount();
+        RoutesInternalData data(vertex_count);
+        if (view_.weights) {
+            std::copy(view_.weights, view_.weights + vertex_count * vertex_count,
+                      data.weights.begin());
+            std::copy(view_.prev_edges, view_.prev_edges + vertex_count * vertex_count,
+                      data.prev_edges.begin());
+        } else {
+            for (VertexId from = 0; from < vertex_count; ++from) {
+                row_source_->ReadRow(from, data.weights.data() + from * vertex_count,
+                                     data.prev_edges.data() + from * vertex_count);
+            }
+        }
+        return data;
+    }
+
+    // Инкрементальная релаксация готовой матрицы новым или подешевевшим
+    // ребром (from, to, weight): одна O(V^2) проходка вместо полного
+    // O(V^3) пересчёта. Корректна только для невозрастающих изменений —
+    // подорожавшее или удалённое ребро так не починить.
+    static void RelaxWithEdge(RoutesInternalData& data, VertexId from, VertexId to,
+                              Weight weight, EdgeId edge_id) {
+        const size_t vertex_count = data.vertex_count;
+        const Weight* weights_to = data.weights.data() + to * vertex_count;
+        const EdgeId* prev_edges_to = data.prev_edges.data() + to * vertex_count;
+
+        for (VertexId i = 0; i < vertex_count; ++i) {
+            const Weight weight_to_from = data.weights[i * vertex_count + from];
+            if (weight_to_from == INFINITE_WEIGHT) {
+                continue;
+            }
+            const Weight base = weight_to_from + weight;
+            Weight* weights_i = data.weights.data() + i * vertex_count;
+            EdgeId* prev_edges_i = data.prev_edges.data() + i * vertex_count;
+
+            for (VertexId j = 0; j < vertex_count; ++j) {
+                const Weight candidate = base + weights_to[j];
+                if (candidate < weights_i[j]) {
+                    weights_i[j] = candidate;
+                    prev_edges_i[j] = prev_edges_to[j] != NO_EDGE ? prev_edges_to[j]
+                                                                  : edge_id;
+                }
+            }
+        }
     }
 
 private:
+    // Строка матрицы, поднятая в память ленивым источником.
+    struct ResidentRow {
+        std::vector<Weight> weights;
+        std::vector<EdgeId> prev_edges;
+    };
+
+    size_t Index(VertexId from, VertexId to) const {
+        return from * data_.vertex_count + to;
+    }
+
+    size_t VertexCount() const {
+        if (row_source_) {
+            return row_source_->GetVertexCount();
+        }
+        return view_.weights ? view_.vertex_count : data_.vertex_count;
+    }
+
+    const Weight* Weights() const {
+        return view_.weights ? view_.weights : data_.weights.data();
+    }
+
+    const EdgeId* PrevEdges() const {
+        return view_.weights ? view_.prev_edges : data_.prev_edges.data();
+    }
+
+    bool BuildRouteFromRow(VertexId to, const Weight* weights_row, const EdgeId* prev_edges_row,
+                           Weight& weight, std::vector<EdgeId>& edges) const;
+
+    // Возвращает строку from, при необходимости подгружая её из источника.
+    // Потокобезопасен: BuildRoute зовётся из пула обработчиков stat-запросов.
+    // shared_ptr держит строку живой, даже если её успели вытеснить.
+    std::shared_ptr<const ResidentRow> FetchRow(VertexId from) const {
+        std::lock_guard guard(rows_mutex_);
+
+        if (auto it = resident_rows_.find(from); it != resident_rows_.end()) {
+            rows_lru_.splice(rows_lru_.begin(), rows_lru_, it->second.second);
+            return it->second.first;
+        }
+
+        auto row = std::make_shared<ResidentRow>();
+        const size_t vertex_count = row_source_->GetVertexCount();
+        row->weights.resize(vertex_count);
+        row->prev_edges.resize(vertex_count);
+        row_source_->ReadRow(from, row->weights.data(), row->prev_edges.data());
+
+        rows_lru_.push_front(from);
+        resident_rows_.emplace(from, std::pair{row, rows_lru_.begin()});
+
+        if (resident_rows_.size() > max_resident_rows_) {
+            resident_rows_.erase(rows_lru_.back());
+            rows_lru_.pop_back();
+        }
+
+        return row;
+    }
+
     void InitializeRoutesInternalData(const Graph& graph) {
         const size_t vertex_count = graph.GetVertexCount();
         for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
-            routes_internal_data_[vertex][vertex] = RouteInternalData{ZERO_WEIGHT, std::nullopt};
+            data_.weights[Index(vertex, vertex)] = ZERO_WEIGHT;
             for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
                 const auto& edge = graph.GetEdge(edge_id);
                 if (edge.weight < ZERO_WEIGHT) {
                     throw std::domain_error("Edges' weights should be non-negative");
                 }
-                auto& route_internal_data = routes_internal_data_[vertex][edge.to];
-                if (!route_internal_data || route_internal_data->weight > edge.weight) {
-                    route_internal_data = RouteInternalData{edge.weight, edge_id};
+                const size_t index = Index(vertex, edge.to);
+                if (edge.weight < data_.weights[index]) {
+                    data_.weights[index] = edge.weight;
+                    data_.prev_edges[index] = edge_id;
                 }
             }
         }
     }
 
-    void RelaxRoute(VertexId vertex_from, VertexId vertex_to, const RouteInternalData& route_from,
-                    const RouteInternalData& route_to) {
-        auto& route_relaxing = routes_internal_data_[vertex_from][vertex_to];
-        const Weight candidate_weight = route_from.weight + route_to.weight;
-        if (!route_relaxing || candidate_weight < route_relaxing->weight) {
-            route_relaxing = {candidate_weight,
-                              route_to.prev_edge ? route_to.prev_edge : route_from.prev_edge};
-        }
-    }
+    // Релаксация тайла [i_first, i_last) x [j_first, j_last) через все
+    // промежуточные вершины [k_first, k_last). Внешний цикл по k обязателен
+    // для корректности зависимого (диагонального) блока.
+    void RelaxBlock(VertexId k_first, VertexId k_last, VertexId i_first, VertexId i_last,
+                    VertexId j_first, VertexId j_last) {
+        const size_t vertex_count = data_.vertex_count;
+        for (VertexId k = k_first; k < k_last; ++k) {
+            const Weight* weights_k = data_.weights.data() + k * vertex_count;
+            const EdgeId* prev_edges_k = data_.prev_edges.data() + k * vertex_count;
+
+            for (VertexId i = i_first; i < i_last; ++i) {
+                const Weight weight_ik = data_.weights[Index(i, k)];
+                if (weight_ik == INFINITE_WEIGHT) {
+                    continue;
+                }
+                const EdgeId prev_edge_ik = data_.prev_edges[Index(i, k)];
+                Weight* weights_i = data_.weights.data() + i * vertex_count;
+                EdgeId* prev_edges_i = data_.prev_edges.data() + i * vertex_count;
 
-    void RelaxRoutesInternalDataThroughVertex(size_t vertex_count, VertexId vertex_through) {
-        for (VertexId vertex_from = 0; vertex_from < vertex_count; ++vertex_from) {
-            if (const auto& route_from = routes_internal_data_[vertex_from][vertex_through]) {
-                for (VertexId vertex_to = 0; vertex_to < vertex_count; ++vertex_to) {
-                    if (const auto& route_to = routes_internal_data_[vertex_through][vertex_to]) {
-                        RelaxRoute(vertex_from, vertex_to, *route_from, *route_to);
+                for (VertexId j = j_first; j < j_last; ++j) {
+                    const Weight candidate = weight_ik + weights_k[j];
+                    if (candidate < weights_i[j]) {
+                        weights_i[j] = candidate;
+                        prev_edges_i[j] = prev_edges_k[j] != NO_EDGE ? prev_edges_k[j]
+                                                                     : prev_edge_ik;
                     }
                 }
             }
         }
     }
 
+    // Обрабатывает список независимых блоков, раздавая их потокам через
+    // общий атомарный счётчик.
+    void RelaxBlocksInParallel(VertexId k_first, VertexId k_last,
+                               const std::vector<std::pair<size_t, size_t>>& blocks,
+                               size_t thread_count) {
+        std::atomic<size_t> next_block{0};
+
+        auto worker = [&] {
+            for (size_t index = next_block++; index < blocks.size(); index = next_block++) {
+                const auto [i_block, j_block] = blocks[index];
+                RelaxBlock(k_first, k_last,
+                           i_block * BLOCK_SIZE, BlockEnd(i_block),
+                           j_block * BLOCK_SIZE, BlockEnd(j_block));
+            }
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(thread_count - 1);
+        for (size_t i = 1; i < std::min(thread_count, blocks.size()); ++i) {
+            threads.emplace_back(worker);
+        }
+        worker();
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    VertexId BlockEnd(size_t block) const {
+        return std::min((block + 1) * BLOCK_SIZE, data_.vertex_count);
+    }
+
+    // Размер тайла подобран так, чтобы три блока матрицы помещались в L2.
+    static constexpr size_t BLOCK_SIZE = 64;
+
     static constexpr Weight ZERO_WEIGHT{};
     const Graph& graph_;
-    RoutesInternalData routes_internal_data_;
+    RoutesInternalData data_;
+    RoutesDataView view_;
+
+    std::unique_ptr<RowSource> row_source_;
+    size_t max_resident_rows_ = 0;
+    mutable std::mutex rows_mutex_;
+    mutable std::list<VertexId> rows_lru_;  // в начале — самая свежая строка
+    mutable std::unordered_map<VertexId,
+            std::pair<std::shared_ptr<const ResidentRow>, typename std::list<VertexId>::iterator>>
+        resident_rows_;
 };
 
 template <typename Weight>
 Router<Weight>::Router(const Graph& graph)
     : graph_(graph)
-    , routes_internal_data_(graph.GetVertexCount(),
-                            std::vector<std::optional<RouteInternalData>>(graph.GetVertexCount()))
+    , data_(graph.GetVertexCount())
+{
+    InitializeRoutesInternalData(graph);
+
+    const size_t vertex_count = graph.GetVertexCount();
+    RelaxBlock(0, vertex_count, 0, vertex_count, 0, vertex_count);
+}
+
+template <typename Weight>
+Router<Weight>::Router(const Graph& graph, size_t thread_count)
+    : graph_(graph)
+    , data_(graph.GetVertexCount())
 {
     InitializeRoutesInternalData(graph);
 
     const size_t vertex_count = graph.GetVertexCount();
-    for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through) {
-        RelaxRoutesInternalDataThroughVertex(vertex_count, vertex_through);
+    if (thread_count < 2 || vertex_count <= BLOCK_SIZE) {
+        RelaxBlock(0, vertex_count, 0, vertex_count, 0, vertex_count);
+        return;
+    }
+
+    const size_t block_count = (vertex_count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+    for (size_t k_block = 0; k_block < block_count; ++k_block) {
+        const VertexId k_first = k_block * BLOCK_SIZE;
+        const VertexId k_last = BlockEnd(k_block);
+
+        // Фаза 1: диагональный блок зависит сам от себя — считаем в одном потоке.
+        RelaxBlock(k_first, k_last, k_first, k_last, k_first, k_last);
+
+        // Фаза 2: блоки строки и столбца k зависят только от диагонального.
+        std::vector<std::pair<size_t, size_t>> cross_blocks;
+        cross_blocks.reserve(2 * (block_count - 1));
+        for (size_t block = 0; block < block_count; ++block) {
+            if (block != k_block) {
+                cross_blocks.emplace_back(block, k_block);
+                cross_blocks.emplace_back(k_block, block);
+            }
+        }
+        RelaxBlocksInParallel(k_first, k_last, cross_blocks, thread_count);
+
+        // Фаза 3: остальные блоки независимы друг от друга.
+        std::vector<std::pair<size_t, size_t>> outer_blocks;
+        outer_blocks.reserve((block_count - 1) * (block_count - 1));
+        for (size_t i_block = 0; i_block < block_count; ++i_block) {
+            for (size_t j_block = 0; j_block < block_count; ++j_block) {
+                if (i_block != k_block && j_block != k_block) {
+                    outer_blocks.emplace_back(i_block, j_block);
+                }
+            }
+        }
+        RelaxBlocksInParallel(k_first, k_last, outer_blocks, thread_count);
     }
 }
 
 template <typename Weight>
 Router<Weight>::Router(const Graph& graph, RoutesInternalData routes_data) :
     graph_(graph),
-    routes_internal_data_(move(routes_data)) {
+    data_(std::move(routes_data)) {
+}
+
+template <typename Weight>
+Router<Weight>::Router(const Graph& graph, RoutesDataView routes_view) :
+    graph_(graph),
+    view_(routes_view) {
+}
+
+template <typename Weight>
+Router<Weight>::Router(const Graph& graph, std::unique_ptr<RowSource> row_source,
+                       size_t max_resident_rows) :
+    graph_(graph),
+    row_source_(std::move(row_source)),
+    max_resident_rows_(std::max<size_t>(max_resident_rows, 1)) {
 }
 
 template <typename Weight>
 std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from,
                                                                              VertexId to) const {
-    const auto& route_internal_data = routes_internal_data_.at(from).at(to);
-    if (!route_internal_data) {
+    RouteInfo info;
+    if (!BuildRoute(from, to, info.weight, info.edges)) {
+        return std::nullopt;
+    }
+    return info;
+}
+
+template <typename Weight>
+bool Router<Weight>::BuildRoute(VertexId from, VertexId to, Weight& weight,
+                                std::vector<EdgeId>& edges) const {
+    const size_t vertex_count = VertexCount();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+
+    // Восстановление пути читает только строку from обоих слоёв, поэтому
+    // ленивому источнику достаточно одной строки на запрос.
+    if (row_source_) {
+        const auto row = FetchRow(from);
+        return BuildRouteFromRow(to, row->weights.data(), row->prev_edges.data(), weight, edges);
+    }
+
+    return BuildRouteFromRow(to, Weights() + from * vertex_count,
+                             PrevEdges() + from * vertex_count, weight, edges);
+}
+
+template <typename Weight>
+bool Router<Weight>::BuildRouteFromRow(VertexId to, const Weight* weights_row,
+                                       const EdgeId* prev_edges_row, Weight& weight,
+                                       std::vector<EdgeId>& edges) const {
+    edges.clear();
+    weight = weights_row[to];
+    if (weight == INFINITE_WEIGHT) {
+        return false;
+    }
+
+    for (EdgeId edge_id = prev_edges_row[to];
+         edge_id != NO_EDGE;
+         edge_id = prev_edges_row[graph_.GetEdge(edge_id).from])
+    {
+        edges.push_back(edge_id);
+    }
+    std::reverse(edges.begin(), edges.end());
+
+    return true;
+}
+
+/*
+ * Альтернатива Router: не хранит матрицу всех пар, а ищет кратчайший путь
+ * по требованию алгоритмом Дейкстры с двоичной кучей. Память O(V + E),
+ * конструктор не выполняет предрасчёта, поэтому подходит для графов,
+ * где O(V²) матрица Router уже не помещается в память.
+ */
+template <typename Weight>
+class DijkstraRouter {
+public:
+    using Graph = DirectedWeightedGraph<Weight>;
+    using RouteInfo = typename Router<Weight>::RouteInfo;
+
+    explicit DijkstraRouter(const Graph& graph)
+        : graph_(graph) {
+        for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+            if (graph.GetEdge(edge_id).weight < ZERO_WEIGHT) {
+                throw std::domain_error("Edges' weights should be non-negative");
+            }
+        }
+    }
+
+    // Поиск ведётся заново при каждом вызове и не использует общего
+    // изменяемого состояния, поэтому метод безопасно звать из разных потоков.
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+
+private:
+    static constexpr Weight ZERO_WEIGHT{};
+    const Graph& graph_;
+};
+
+template <typename Weight>
+std::optional<typename DijkstraRouter<Weight>::RouteInfo> DijkstraRouter<Weight>::BuildRoute(
+        VertexId from, VertexId to) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+
+    std::vector<std::optional<Weight>> distances(vertex_count);
+    std::vector<std::optional<EdgeId>> prev_edges(vertex_count);
+    std::vector<bool> visited(vertex_count);
+
+    using QueueItem = std::pair<Weight, VertexId>;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+
+    distances[from] = ZERO_WEIGHT;
+    queue.push({ZERO_WEIGHT, from});
+
+    while (!queue.empty()) {
+        const auto [distance, vertex] = queue.top();
+        queue.pop();
+
+        if (visited[vertex]) {
+            continue;
+        }
+        visited[vertex] = true;
+
+        if (vertex == to) {
+            break;
+        }
+
+        for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+            const auto& edge = graph_.GetEdge(edge_id);
+            const Weight candidate = distance + edge.weight;
+            if (!distances[edge.to] || candidate < *distances[edge.to]) {
+                distances[edge.to] = candidate;
+                prev_edges[edge.to] = edge_id;
+                queue.push({candidate, edge.to});
+            }
+        }
+    }
+
+    if (!distances[to]) {
         return std::nullopt;
     }
-    const Weight weight = route_internal_data->weight;
+
     std::vector<EdgeId> edges;
-    for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge;
+    for (std::optional<EdgeId> edge_id = prev_edges[to];
          edge_id;
-         edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge)
+         edge_id = prev_edges[graph_.GetEdge(*edge_id).from])
     {
         edges.push_back(*edge_id);
     }
     std::reverse(edges.begin(), edges.end());
 
-    return RouteInfo{weight, std::move(edges)};
+    return RouteInfo{*distances[to], std::move(edges)};
 }
 
 }  // namespace graph
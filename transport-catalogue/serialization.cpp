@@ -1,22 +1,396 @@
 #include "serialization.h"
 #include "domain.h"
 #include "map_renderer.h"
+#include "request_handler.h"
 #include "transport_catalogue.h"
 #include "graph.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TRANSPORT_CATALOGUE_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 using namespace std;
 
 namespace transport_catalogue_serialize {
 
-void Serialize(const transport_catalogue::TransportCatalogue& transport_catalogue,
-               const renderer::MapRenderer& map_renderer,
-               const transport_catalogue::TransportRouter& transport_router,
-               std::ostream &output) {
+namespace {
+
+/*
+ * Формат mmap-базы (поля в нативном порядке байт, файл потребляется на
+ * машинах той же архитектуры, на которой собран):
+ *   8 байт   магия "TCDBMMAP"
+ *   uint32   версия формата
+ *   uint32   флаги (зарезервированы)
+ *   uint64   размер protobuf-блоба
+ *   ...      protobuf Database (каталог, рендерер, настройки роутера)
+ *   паддинг до кратности 8
+ *   uint64   vertex_count матрицы (0 — матрицы нет)
+ *   ...      слой весов: vertex_count^2 double
+ *   ...      слой рёбер: vertex_count^2 EdgeId
+ *
+ * С флагом DB_FLAG_COMPACT_ROUTER вместо сырых слоёв после vertex_count идут:
+ *   uint64   offsets[vertex_count + 1] — смещения строк от начала блобов
+ *   ...      закодированные строки матрицы (см. EncodeRouteRow)
+ */
+constexpr char DB_MAGIC[8] = {'T', 'C', 'D', 'B', 'M', 'M', 'A', 'P'};
+constexpr uint32_t DB_VERSION = 1;
+constexpr uint32_t DB_FLAG_COMPACT_ROUTER = 1;
+
+template <typename T>
+void WriteRaw(ostream& output, const T& value) {
+    output.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+T ReadRaw(istream& input) {
+    T value{};
+    input.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return value;
+}
+
+size_t AlignUp(size_t offset) {
+    return (offset + 7) & ~static_cast<size_t>(7);
+}
+
+/*
+ * Ленивый источник строк матрицы: читает из файла базы строку исходной
+ * вершины по требованию. Слои лежат построчно, поэтому строка — два
+ * последовательных чтения. Синхронизацию обеспечивает Router::FetchRow.
+ */
+class FileRowSource final : public transport_catalogue::TransportRouter::Router::RowSource {
+public:
+    FileRowSource(const string& path, size_t vertex_count, size_t planes_offset)
+        : input_(path, ios::binary)
+        , vertex_count_(vertex_count)
+        , planes_offset_(planes_offset) {
+    }
+
+    size_t GetVertexCount() const override {
+        return vertex_count_;
+    }
+
+    void ReadRow(graph::VertexId from, double* weights, graph::EdgeId* prev_edges) override {
+        input_.seekg(planes_offset_ + from * vertex_count_ * sizeof(double));
+        input_.read(reinterpret_cast<char*>(weights), vertex_count_ * sizeof(double));
+
+        input_.seekg(planes_offset_ + vertex_count_ * vertex_count_ * sizeof(double)
+                     + from * vertex_count_ * sizeof(graph::EdgeId));
+        input_.read(reinterpret_cast<char*>(prev_edges), vertex_count_ * sizeof(graph::EdgeId));
+
+        // Размеры проверены при открытии базы, но файл могли подменить или
+        // усечь после: недочитанная строка не должна уходить наверх мусором.
+        if (!input_) {
+            throw runtime_error("Transport database is truncated"s);
+        }
+    }
+
+private:
+    ifstream input_;
+    size_t vertex_count_;
+    size_t planes_offset_;
+};
+
+void AppendVarint(string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+uint64_t ReadVarint(const char*& ptr) {
+    uint64_t value = 0;
+    for (int shift = 0; ; shift += 7) {
+        const auto byte = static_cast<uint8_t>(*ptr++);
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+}
+
+uint64_t ZigZagEncode(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t ZigZagDecode(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+/*
+ * Кодек строки матрицы. Строка режется на пробеги: недостижимый пробег —
+ * один varint (длина << 1), достижимый — varint (длина << 1 | 1), затем
+ * zigzag-varint дельты номеров рёбер (NO_EDGE кодируется нулём, остальные
+ * со сдвигом на единицу) и сырые double весов. Недостижимые ячейки не
+ * занимают места вовсе, номера рёбер сжимаются с 8 байт до 1-2, веса
+ * остаются побитово точными.
+ */
+string EncodeRouteRow(const double* weights, const graph::EdgeId* prev_edges, size_t count) {
+    using RouterImpl = transport_catalogue::TransportRouter::Router;
+
+    string out;
+    size_t pos = 0;
+    while (pos < count) {
+        size_t run = pos;
+        if (weights[pos] == RouterImpl::INFINITE_WEIGHT) {
+            while (run < count && weights[run] == RouterImpl::INFINITE_WEIGHT) {
+                ++run;
+            }
+            AppendVarint(out, static_cast<uint64_t>(run - pos) << 1);
+            pos = run;
+            continue;
+        }
+
+        while (run < count && weights[run] != RouterImpl::INFINITE_WEIGHT) {
+            ++run;
+        }
+        AppendVarint(out, (static_cast<uint64_t>(run - pos) << 1) | 1);
+
+        uint64_t prev_code = 0;
+        for (size_t i = pos; i < run; ++i) {
+            const uint64_t code = prev_edges[i] == RouterImpl::NO_EDGE ? 0 : prev_edges[i] + 1;
+            AppendVarint(out, ZigZagEncode(static_cast<int64_t>(code) - static_cast<int64_t>(prev_code)));
+            prev_code = code;
+        }
+        out.append(reinterpret_cast<const char*>(weights + pos), (run - pos) * sizeof(double));
+        pos = run;
+    }
+    return out;
+}
+
+void DecodeRouteRow(const char* data, size_t count, double* weights, graph::EdgeId* prev_edges) {
+    using RouterImpl = transport_catalogue::TransportRouter::Router;
+
+    size_t pos = 0;
+    while (pos < count) {
+        const uint64_t tag = ReadVarint(data);
+        const size_t run = static_cast<size_t>(tag >> 1);
+
+        if ((tag & 1) == 0) {
+            fill(weights + pos, weights + pos + run, RouterImpl::INFINITE_WEIGHT);
+            fill(prev_edges + pos, prev_edges + pos + run, RouterImpl::NO_EDGE);
+            pos += run;
+            continue;
+        }
+
+        uint64_t code = 0;
+        for (size_t i = pos; i < pos + run; ++i) {
+            code = static_cast<uint64_t>(static_cast<int64_t>(code) + ZigZagDecode(ReadVarint(data)));
+            prev_edges[i] = code == 0 ? RouterImpl::NO_EDGE : static_cast<graph::EdgeId>(code - 1);
+        }
+        memcpy(weights + pos, data, run * sizeof(double));
+        data += run * sizeof(double);
+        pos += run;
+    }
+}
+
+// Ленивый построчный источник компактной базы: смещения строк держатся в
+// памяти, строка читается одним чтением и разворачивается кодеком.
+class CompactRowSource final : public transport_catalogue::TransportRouter::Router::RowSource {
+public:
+    CompactRowSource(const string& path, size_t vertex_count, size_t rows_offset,
+                     vector<uint64_t> offsets)
+        : input_(path, ios::binary)
+        , vertex_count_(vertex_count)
+        , rows_offset_(rows_offset)
+        , offsets_(move(offsets)) {
+    }
+
+    size_t GetVertexCount() const override {
+        return vertex_count_;
+    }
+
+    void ReadRow(graph::VertexId from, double* weights, graph::EdgeId* prev_edges) override {
+        const size_t size = offsets_[from + 1] - offsets_[from];
+        buffer_.resize(size);
+        input_.seekg(rows_offset_ + offsets_[from]);
+        input_.read(buffer_.data(), size);
+        // См. FileRowSource::ReadRow: декодер нельзя запускать на
+        // недочитанной строке.
+        if (!input_) {
+            throw runtime_error("Transport database is truncated"s);
+        }
+        DecodeRouteRow(buffer_.data(), vertex_count_, weights, prev_edges);
+    }
+
+private:
+    ifstream input_;
+    size_t vertex_count_;
+    size_t rows_offset_;
+    vector<uint64_t> offsets_;
+    string buffer_;
+};
+
+} // namespace
+
+MappedFile::MappedFile(const std::string& path) {
+#ifdef TRANSPORT_CATALOGUE_HAS_MMAP
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat file_stat {};
+    if (::fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+        // Отображение read-only и разделяемое: все process_requests одного
+        // хоста обслуживаются одними и теми же страницами страничного кэша,
+        // N воркеров держат матрицу маршрутов по цене одной копии.
+        void* data = ::mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ,
+                            MAP_SHARED, fd, 0);
+        if (data != MAP_FAILED) {
+            data_ = data;
+            size_ = static_cast<size_t>(file_stat.st_size);
+        }
+    }
+    ::close(fd);
+#else
+    (void)path;
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef TRANSPORT_CATALOGUE_HAS_MMAP
+    if (data_ != nullptr) {
+        ::munmap(data_, size_);
+    }
+#endif
+}
+
+namespace {
+
+// Секции базы, не зависящие от роутера: каталог, настройки рендера и
+// заранее отрисованная карта. Карта неизменна после make_base — рендерим
+// один раз и кладём готовый SVG в базу, Map-запросы отвечают этой строкой.
+Database SerializeRouterIndependentSections(
+        const transport_catalogue::TransportCatalogue& transport_catalogue,
+        const renderer::MapRenderer& map_renderer) {
     Database database;
     *database.mutable_transport_catalogue() = details::Serialize(transport_catalogue);
     *database.mutable_map_renderer() = details::Serialize(map_renderer);
+
+    vector<transport_catalogue::BusPtr> buses;
+    for (const auto bus : transport_catalogue) {
+        if (!bus->stops.empty()) {
+            buses.push_back(bus);
+        }
+    }
+    ostringstream svg_out;
+    map_renderer.RenderMap(buses.begin(), buses.end()).Render(svg_out);
+    database.mutable_map_renderer()->set_rendered_map(svg_out.str());
+
+    return database;
+}
+
+// Запись файла базы: заголовок, protobuf-блоб, выравнивание и матрица
+// роутера (сырая или компактная). Секция роутера должна быть уже в database.
+void WriteDatabase(const Database& database,
+                   const transport_catalogue::TransportRouter& transport_router,
+                   ostream& output, bool compact_router) {
+    string proto_blob;
+    database.SerializeToString(&proto_blob);
+
+    output.write(DB_MAGIC, sizeof(DB_MAGIC));
+    WriteRaw(output, DB_VERSION);
+    WriteRaw(output, compact_router ? DB_FLAG_COMPACT_ROUTER : uint32_t{0});
+    WriteRaw(output, static_cast<uint64_t>(proto_blob.size()));
+    output.write(proto_blob.data(), proto_blob.size());
+
+    size_t offset = sizeof(DB_MAGIC) + 2 * sizeof(uint32_t) + sizeof(uint64_t) + proto_blob.size();
+    for (; offset % 8 != 0; ++offset) {
+        output.put('\0');
+    }
+
+    if (transport_router.GetSettings().engine != transport_catalogue::RouterEngine::AllPairs) {
+        WriteRaw(output, uint64_t{0});
+        return;
+    }
+
+    const auto& data = transport_router.GetRouter().GetRoutesData();
+    WriteRaw(output, static_cast<uint64_t>(data.vertex_count));
+
+    if (!compact_router) {
+        // Слои матрицы пишутся сырыми и выровненными, чтобы process_requests
+        // мог отобразить их в память и читать без десериализации.
+        output.write(reinterpret_cast<const char*>(data.weights.data()),
+                     data.weights.size() * sizeof(double));
+        output.write(reinterpret_cast<const char*>(data.prev_edges.data()),
+                     data.prev_edges.size() * sizeof(graph::EdgeId));
+        return;
+    }
+
+    // Компактный режим: строки независимы, кодируются пулом потоков.
+    const size_t vertex_count = data.vertex_count;
+    vector<string> rows(vertex_count);
+    {
+        atomic<size_t> next_row{0};
+        auto worker = [&] {
+            for (size_t row = next_row.fetch_add(1); row < vertex_count;
+                 row = next_row.fetch_add(1)) {
+                rows[row] = EncodeRouteRow(data.weights.data() + row * vertex_count,
+                                           data.prev_edges.data() + row * vertex_count,
+                                           vertex_count);
+            }
+        };
+
+        vector<thread> workers;
+        const size_t thread_count =
+            min<size_t>(max<size_t>(1, thread::hardware_concurrency()), max<size_t>(1, vertex_count));
+        workers.reserve(thread_count);
+        for (size_t i = 0; i < thread_count; ++i) {
+            workers.emplace_back(worker);
+        }
+        for (auto& worker_thread : workers) {
+            worker_thread.join();
+        }
+    }
+
+    uint64_t row_offset = 0;
+    for (const auto& row : rows) {
+        WriteRaw(output, row_offset);
+        row_offset += row.size();
+    }
+    WriteRaw(output, row_offset);
+    for (const auto& row : rows) {
+        output.write(row.data(), row.size());
+    }
+}
+
+} // namespace
+
+void Serialize(const transport_catalogue::TransportCatalogue& transport_catalogue,
+               const renderer::MapRenderer& map_renderer,
+               const transport_catalogue::TransportRouter& transport_router,
+               std::ostream &output, bool compact_router) {
+    Database database = SerializeRouterIndependentSections(transport_catalogue, map_renderer);
+    *database.mutable_transport_router() = details::Serialize(transport_router);
+    WriteDatabase(database, transport_router, output, compact_router);
+}
+
+void Serialize(const transport_catalogue::TransportCatalogue& transport_catalogue,
+               const renderer::MapRenderer& map_renderer,
+               std::future<transport_catalogue::TransportRouter>&& router_future,
+               std::ostream& output, bool compact_router) {
+    // Сериализация каталога с рендерером и отрисовка карты идут параллельно
+    // с достройкой матрицы в потоке router_future; ожидание начинается
+    // только перед записью секции роутера.
+    Database database = SerializeRouterIndependentSections(transport_catalogue, map_renderer);
+
+    const auto transport_router = router_future.get();
     *database.mutable_transport_router() = details::Serialize(transport_router);
-    database.SerializeToOstream(&output);
+    WriteDatabase(database, transport_router, output, compact_router);
 }
 
 optional<DeserializeResult> Deserialize(istream& input) {
@@ -32,6 +406,7 @@ optional<DeserializeResult> Deserialize(istream& input) {
     auto map_renderer = details::Deserialize(database.map_renderer());
 
     DeserializeResult result{
+        nullptr,
         move(transport_catalogue),
         move(map_renderer),
         move(transport_router)
@@ -40,6 +415,243 @@ optional<DeserializeResult> Deserialize(istream& input) {
     return {move(result)};
 }
 
+optional<DeserializeResult> Deserialize(const string& path) {
+    // Внутри этого пространства имён TransportRouter — protobuf-сообщение,
+    // поэтому класс роутера именуется полностью.
+    using RouteManager = transport_catalogue::TransportRouter;
+
+    {
+        ifstream probe(path, ios::binary);
+        if (!probe) {
+            return nullopt;
+        }
+        char magic[sizeof(DB_MAGIC)]{};
+        probe.read(magic, sizeof(magic));
+        if (!probe || memcmp(magic, DB_MAGIC, sizeof(magic)) != 0) {
+            // Базы без магии — старый чистый protobuf.
+            ifstream ifs(path, ios::binary);
+            return Deserialize(ifs);
+        }
+    }
+
+    const size_t header_size = sizeof(DB_MAGIC) + 2 * sizeof(uint32_t) + sizeof(uint64_t);
+
+    // Компактные базы читаются единственным способом — ленивым построчным
+    // источником с декодером; zero-copy mmap к ним неприменим.
+    {
+        ifstream ifs(path, ios::binary);
+        ifs.seekg(sizeof(DB_MAGIC));
+        const auto version = ReadRaw<uint32_t>(ifs);
+        const auto flags = ReadRaw<uint32_t>(ifs);
+        const auto proto_size = ReadRaw<uint64_t>(ifs);
+        if (!ifs || version != DB_VERSION) {
+            return nullopt;
+        }
+
+        if ((flags & DB_FLAG_COMPACT_ROUTER) != 0) {
+            string proto_blob(proto_size, '\0');
+            ifs.read(proto_blob.data(), proto_blob.size());
+
+            Database database;
+            if (!ifs || !database.ParseFromString(proto_blob)) {
+                return nullopt;
+            }
+
+            ifs.seekg(AlignUp(header_size + proto_size));
+            const auto vertex_count = ReadRaw<uint64_t>(ifs);
+            if (!ifs) {
+                return nullopt;
+            }
+
+            auto catalogue = details::Deserialize(database.transport_catalogue());
+            auto map_renderer = details::Deserialize(database.map_renderer());
+            auto routing_settings = details::Deserialize(database.transport_router().routing_settings());
+
+            if (vertex_count == 0) {
+                // Роутер строится до перемещения каталога в результат:
+                // member-инициализаторы агрегата выполняются по порядку, и
+                // move(catalogue) опустошил бы локальный объект раньше.
+                auto transport_router = RouteManager(move(routing_settings), catalogue);
+                DeserializeResult result{
+                    nullptr,
+                    move(catalogue),
+                    move(map_renderer),
+                    move(transport_router)
+                };
+                return {move(result)};
+            }
+
+            // vertex_count прочитан из файла и не считается доверенным:
+            // таблица смещений обязана помещаться в файл до аллокации по нему.
+            const size_t offsets_pos = AlignUp(header_size + proto_size) + sizeof(uint64_t);
+            ifs.seekg(0, ios::end);
+            const auto file_size = static_cast<uint64_t>(ifs.tellg());
+            if (vertex_count >= (file_size - offsets_pos) / sizeof(uint64_t)) {
+                return nullopt;
+            }
+            ifs.seekg(offsets_pos);
+
+            vector<uint64_t> offsets(vertex_count + 1);
+            ifs.read(reinterpret_cast<char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+            if (!ifs) {
+                return nullopt;
+            }
+
+            const size_t rows_offset = offsets_pos + offsets.size() * sizeof(uint64_t);
+            // ReadRow вычитает соседние смещения и читает по ним без проверок,
+            // поэтому смещения обязаны быть неубывающими, а строки — лежать
+            // внутри файла.
+            if (!is_sorted(offsets.begin(), offsets.end())
+                    || offsets.back() > file_size - rows_offset) {
+                return nullopt;
+            }
+            auto row_source = make_unique<CompactRowSource>(path, vertex_count, rows_offset,
+                                                            move(offsets));
+
+            auto transport_router = RouteManager(move(routing_settings), move(row_source),
+                                                 catalogue);
+            DeserializeResult result{
+                nullptr,
+                move(catalogue),
+                move(map_renderer),
+                move(transport_router)
+            };
+            return {move(result)};
+        }
+    }
+
+#ifdef TRANSPORT_CATALOGUE_HAS_MMAP
+    if (auto mapping = make_shared<MappedFile>(path); *mapping && mapping->Size() >= header_size) {
+        const char* base = mapping->Data();
+        const uint64_t file_size = mapping->Size();
+
+        uint32_t version = 0;
+        memcpy(&version, base + sizeof(DB_MAGIC), sizeof(version));
+        uint64_t proto_size = 0;
+        memcpy(&proto_size, base + sizeof(DB_MAGIC) + 2 * sizeof(uint32_t), sizeof(proto_size));
+
+        // Размеры из заголовка не считаются доверенными: у усечённой или
+        // битой базы чтение за границей отображения валит процесс SIGBUS,
+        // поэтому каждое смещение проверяется до обращения к данным.
+        bool bounds_ok = version == DB_VERSION && proto_size <= file_size - header_size;
+
+        uint64_t vertex_count = 0;
+        size_t offset = bounds_ok ? AlignUp(header_size + proto_size) : 0;
+        if (bounds_ok && offset + sizeof(vertex_count) <= file_size) {
+            memcpy(&vertex_count, base + offset, sizeof(vertex_count));
+            offset += sizeof(vertex_count);
+            // Оба слоя матрицы — vertex_count^2 ячеек; сравнение через
+            // деление, чтобы квадрат не переполнился на мусорном значении.
+            const uint64_t cell_size = sizeof(double) + sizeof(graph::EdgeId);
+            bounds_ok = vertex_count == 0
+                || vertex_count <= (file_size - offset) / cell_size / vertex_count;
+        } else {
+            bounds_ok = false;
+        }
+
+        Database database;
+        if (bounds_ok
+                && database.ParseFromArray(base + header_size, static_cast<int>(proto_size))) {
+
+            auto catalogue = details::Deserialize(database.transport_catalogue());
+            auto map_renderer = details::Deserialize(database.map_renderer());
+            auto routing_settings = details::Deserialize(database.transport_router().routing_settings());
+
+            // Матрица читается прямо из отображённого файла, без копий.
+            auto transport_router = vertex_count > 0
+                ? RouteManager(move(routing_settings),
+                               RouteManager::Router::RoutesDataView{
+                                   static_cast<size_t>(vertex_count),
+                                   reinterpret_cast<const double*>(base + offset),
+                                   reinterpret_cast<const graph::EdgeId*>(
+                                       base + offset + vertex_count * vertex_count * sizeof(double))},
+                               catalogue)
+                : RouteManager(move(routing_settings), catalogue);
+
+            DeserializeResult result{
+                move(mapping),
+                move(catalogue),
+                move(map_renderer),
+                move(transport_router)
+            };
+
+            return {move(result)};
+        }
+    }
+#endif
+
+    // Фолбэк без mmap: тот же формат, строки матрицы подгружаются лениво.
+    ifstream ifs(path, ios::binary);
+    ifs.seekg(sizeof(DB_MAGIC));
+
+    const auto version = ReadRaw<uint32_t>(ifs);
+    ReadRaw<uint32_t>(ifs);  // флаги
+    const auto proto_size = ReadRaw<uint64_t>(ifs);
+    if (!ifs || version != DB_VERSION) {
+        return nullopt;
+    }
+
+    string proto_blob(proto_size, '\0');
+    ifs.read(proto_blob.data(), proto_blob.size());
+
+    Database database;
+    if (!ifs || !database.ParseFromString(proto_blob)) {
+        return nullopt;
+    }
+
+    ifs.seekg(AlignUp(header_size + proto_size));
+    const auto vertex_count = ReadRaw<uint64_t>(ifs);
+    if (!ifs) {
+        return nullopt;
+    }
+
+    // Слои матрицы обязаны целиком лежать в файле — иначе FileRowSource
+    // вернул бы мусор с середины усечённой базы. Сравнение через деление,
+    // чтобы квадрат не переполнился на битом vertex_count.
+    {
+        const size_t planes_pos = AlignUp(header_size + proto_size) + sizeof(uint64_t);
+        ifs.seekg(0, ios::end);
+        const auto file_size = static_cast<uint64_t>(ifs.tellg());
+        const uint64_t cell_size = sizeof(double) + sizeof(graph::EdgeId);
+        if (vertex_count > 0
+                && vertex_count > (file_size - planes_pos) / cell_size / vertex_count) {
+            return nullopt;
+        }
+    }
+
+    auto catalogue = details::Deserialize(database.transport_catalogue());
+    auto map_renderer = details::Deserialize(database.map_renderer());
+    auto routing_settings = details::Deserialize(database.transport_router().routing_settings());
+
+    if (vertex_count == 0) {
+        // См. комментарий в компактной ветке: роутер строится до перемещения
+        // каталога в агрегат результата.
+        auto transport_router = RouteManager(move(routing_settings), catalogue);
+        DeserializeResult result{
+            nullptr,
+            move(catalogue),
+            move(map_renderer),
+            move(transport_router)
+        };
+        return {move(result)};
+    }
+
+    // Матрица целиком в память не читается: строки поднимает по требованию
+    // ленивый источник с LRU-ограничением резидентного набора.
+    const size_t planes_offset = AlignUp(header_size + proto_size) + sizeof(uint64_t);
+    auto row_source = make_unique<FileRowSource>(path, vertex_count, planes_offset);
+
+    auto transport_router = RouteManager(move(routing_settings), move(row_source), catalogue);
+    DeserializeResult result{
+        nullptr,
+        move(catalogue),
+        move(map_renderer),
+        move(transport_router)
+    };
+
+    return {move(result)};
+}
+
 namespace details {
 
 TransportCatalogue Serialize(const transport_catalogue::TransportCatalogue& transport_catalogue) {
@@ -67,6 +679,17 @@ TransportCatalogue Serialize(const transport_catalogue::TransportCatalogue& tran
         for (auto* stop : bus.stops) {
             object.add_stop_id(stop_to_id[stop]);
         }
+
+        // Статистика маршрута неизменна — кладём её в базу, чтобы
+        // process_requests не пересчитывал дистанции на каждый запрос.
+        if (const auto stat = transport_catalogue.GetBusStat(bus.name)) {
+            auto& stat_object = *object.mutable_stat();
+            stat_object.set_stops_amount(static_cast<uint32_t>(stat->stops_amount));
+            stat_object.set_unique_stops_amount(static_cast<uint32_t>(stat->unique_stops_amount));
+            stat_object.set_route_length(stat->route_length);
+            stat_object.set_curvature(stat->curvature);
+        }
+
         *bus_list.add_bus() = move(object);
     }
 
@@ -81,6 +704,10 @@ transport_catalogue::TransportCatalogue Deserialize(const TransportCatalogue& ob
     vector<transport_catalogue::StopPtr> all_stops;
     all_stops.reserve(stop_list.stop_size());
 
+    // Числа известны из базы — hash-индексы резервируются заранее, без
+    // рехеширований по ходу наполнения.
+    transport_catalogue.Reserve(stop_list.stop_size(), object.bus_list().bus_size());
+
     for (int stop_id = 0; stop_id < stop_list.stop_size(); ++stop_id) {
         const auto& stop_raw = stop_list.stop(stop_id);
 
@@ -121,8 +748,21 @@ transport_catalogue::TransportCatalogue Deserialize(const TransportCatalogue& ob
             bus.is_roundtrip(),
             move(bus_stops)
         });
+
+        if (bus.has_stat()) {
+            const auto& stat = bus.stat();
+            transport_catalogue.SetBusStat(*transport_catalogue.FindBus(bus.name()), {
+                stat.stops_amount(),
+                stat.unique_stops_amount(),
+                stat.route_length(),
+                stat.curvature()
+            });
+        }
     }
 
+    // Старые базы без сохранённой статистики: досчитываем недостающее.
+    transport_catalogue.BuildBusStats();
+
     return transport_catalogue;
 }
 
@@ -133,21 +773,36 @@ MapRenderer Serialize(const renderer::MapRenderer& map_renderer) {
 }
 
 renderer::MapRenderer Deserialize(const MapRenderer& object) {
-    return renderer::MapRenderer(Deserialize(object.render_settings()));
+    renderer::MapRenderer map_renderer(Deserialize(object.render_settings()));
+    if (!object.rendered_map().empty()) {
+        map_renderer.SetRenderedMap(object.rendered_map());
+    }
+    return map_renderer;
 }
 
 TransportRouter Serialize(const transport_catalogue::TransportRouter& transport_router) {
     TransportRouter object;
     *object.mutable_routing_settings() = Serialize(transport_router.GetSettings());
-    *object.mutable_router() = Serialize(transport_router.GetRouter());
+    // Матрица в protobuf больше не кладётся: она уходит в файл сырыми
+    // выровненными слоями (см. Serialize выше), а protobuf-поле router
+    // остаётся только для чтения старых баз.
     return object;
 }
 
 transport_catalogue::TransportRouter Deserialize(const TransportRouter& object, const transport_catalogue::TransportCatalogue& transport_catalogue) {
+    auto routing_settings = Deserialize(object.routing_settings());
+
+    if (routing_settings.engine == transport_catalogue::RouterEngine::Dijkstra) {
+        return {
+            move(routing_settings),
+            transport_catalogue,
+        };
+    }
+
     auto router_data = Deserialize(object.router());
 
     return {
-        Deserialize(object.routing_settings()),
+        move(routing_settings),
         move(router_data),
         transport_catalogue,
     };
@@ -156,7 +811,7 @@ transport_catalogue::TransportRouter Deserialize(const TransportRouter& object,
 Stop Serialize(const transport_catalogue::Stop& stop) {
     Stop object;
 
-    object.set_name(stop.name);
+    object.set_name(stop.name.data(), stop.name.size());
     object.set_lat(stop.coordinates.lat);
     object.set_lng(stop.coordinates.lng);
 
@@ -166,7 +821,7 @@ Stop Serialize(const transport_catalogue::Stop& stop) {
 Bus Serialize(const transport_catalogue::Bus& bus) {
     Bus object;
 
-    object.set_name(bus.name);
+    object.set_name(bus.name.data(), bus.name.size());
     object.set_is_roundtrip(bus.is_roundtrip);
 
     return object;
@@ -226,6 +881,7 @@ RoutingSettings Serialize(const transport_catalogue::RoutingSettings& routing_se
 
     object.set_bus_wait_time(routing_settings.bus_wait_time);
     object.set_bus_velocity(routing_settings.bus_velocity);
+    object.set_engine(static_cast<int32_t>(routing_settings.engine));
 
     return object;
 }
@@ -235,45 +891,19 @@ transport_catalogue::RoutingSettings Deserialize(const RoutingSettings& object)
 
     routing_settings.bus_wait_time = object.bus_wait_time();
     routing_settings.bus_velocity = object.bus_velocity();
+    routing_settings.engine = static_cast<transport_catalogue::RouterEngine>(object.engine());
 
     return routing_settings;
 }
 
-Router Serialize(const transport_catalogue::TransportRouter::Router& router) {
-    Router object;
-
-    for (const auto& routes : router.GetRoutesRange()) {
-        auto& route_list = *object.add_route_list();
-
-        for (const auto& route : routes) {
-            auto& route_object = *route_list.add_route();
-
-            if (route) {
-                RouteData data;
-                data.set_weight(route->weight);
-
-                if (route->prev_edge) {
-                    EdgeId edge_id;
-                    edge_id.set_id(*route->prev_edge);
-                    *data.mutable_prev_edge() = move(edge_id);
-                }
-
-                *route_object.mutable_data() = move(data);
-            }
-        }
-    }
-
-    return object;
-}
-
 transport_catalogue::TransportRouter::Router::RoutesInternalData Deserialize(const Router& object) {
-    using RouteInternalData = transport_catalogue::TransportRouter::Router::RouteInternalData;
-    using RoutesInternalData = transport_catalogue::TransportRouter::Router::RoutesInternalData;
+    using RouterImpl = transport_catalogue::TransportRouter::Router;
+    using RoutesInternalData = RouterImpl::RoutesInternalData;
 
-    int vertex_count = object.route_list_size();
-    RoutesInternalData data(vertex_count, vector<optional<RouteInternalData>>(vertex_count));
+    const size_t vertex_count = object.route_list_size();
+    RoutesInternalData data(vertex_count);
 
-    for (int from_id = 0; from_id < vertex_count; ++from_id) {
+    for (size_t from_id = 0; from_id < vertex_count; ++from_id) {
         const auto& route_list = object.route_list(from_id);
 
         for (int to_id = 0; to_id < route_list.route_size(); ++to_id) {
@@ -281,16 +911,12 @@ transport_catalogue::TransportRouter::Router::RoutesInternalData Deserialize(con
 
             if (route.has_data()) {
                 const auto& route_data = route.data();
-                optional<graph::EdgeId> prev_edge;
+                const size_t index = from_id * vertex_count + to_id;
 
+                data.weights[index] = route_data.weight();
                 if (route_data.has_prev_edge()) {
-                    prev_edge = route_data.prev_edge().id();
+                    data.prev_edges[index] = route_data.prev_edge().id();
                 }
-
-                data[from_id][to_id] = {
-                    route_data.weight(),
-                    prev_edge
-                };
             }
         }
     }
@@ -4,24 +4,91 @@
 #include "transport_router.h"
 #include "svg.h"
 
+#include <future>
 #include <iostream>
+#include <memory>
 #include <optional>
+#include <string>
 #include <transport_catalogue.pb.h>
 
 namespace transport_catalogue_serialize {
 
+/*
+ * RAII-обёртка файла, отображённого в память (mmap, только чтение).
+ * Держит отображение живым, пока на него ссылаются нулевые копии —
+ * прежде всего слои матрицы Router. На платформах без mmap отображение
+ * не создаётся (operator bool возвращает false).
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    explicit operator bool() const {
+        return data_ != nullptr;
+    }
+
+    const char* Data() const {
+        return static_cast<const char*>(data_);
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+
+private:
+    void* data_ = nullptr;
+    size_t size_ = 0;
+};
+
 struct DeserializeResult {
+    // Отображение объявлено первым, чтобы разрушаться последним: router
+    // может читать матрицу прямо из него.
+    std::shared_ptr<MappedFile> mapping;
     transport_catalogue::TransportCatalogue transport_catalogue;
     renderer::MapRenderer map_renderer;
     transport_catalogue::TransportRouter route_manager;
 };
 
+/*
+ * compact_router включает компактную запись матрицы: строки кодируются
+ * RLE-пробегами недостижимых ячеек и zigzag-varint дельтами номеров рёбер
+ * (веса достижимых ячеек остаются точными double) и пишутся со своей
+ * таблицей смещений, так что читается файл тем же ленивым построчным
+ * источником. Сжатые базы на порядок меньше, но несовместимы с zero-copy
+ * mmap-чтением.
+ */
 void Serialize(const transport_catalogue::TransportCatalogue& transport_catalogue,
                const renderer::MapRenderer& map_renderer,
-               const transport_catalogue::TransportRouter& transport_router, std::ostream &output);
+               const transport_catalogue::TransportRouter& transport_router, std::ostream &output,
+               bool compact_router = false);
+
+/*
+ * Конвейерный вариант для make_base: секции, не зависящие от роутера
+ * (каталог, настройки рендера, готовая карта), сериализуются, пока фоновый
+ * поток router_future достраивает матрицу; затем дописываются секция
+ * роутера и сама матрица. Файл на выходе идентичен обычному Serialize.
+ */
+void Serialize(const transport_catalogue::TransportCatalogue& transport_catalogue,
+               const renderer::MapRenderer& map_renderer,
+               std::future<transport_catalogue::TransportRouter>&& router_future,
+               std::ostream& output, bool compact_router = false);
 
+// Старый формат: чистый protobuf без заголовка.
 std::optional<DeserializeResult> Deserialize(std::istream& input);
 
+/*
+ * Определяет формат по магии в заголовке файла: новые базы (protobuf-блоб
+ * настроек плюс выровненные сырые слои матрицы) отображаются в память и
+ * матрица используется без копирования; без mmap слои вычитываются в
+ * собственные буферы; файлы без магии читаются старым protobuf-путём.
+ */
+std::optional<DeserializeResult> Deserialize(const std::string& path);
+
 namespace details {
 
 TransportCatalogue Serialize(const transport_catalogue::TransportCatalogue& transport_catalogue);
@@ -42,7 +109,6 @@ renderer::RenderSettings Deserialize(const RenderSettings& object);
 RoutingSettings Serialize(const transport_catalogue::RoutingSettings& routing_settings);
 transport_catalogue::RoutingSettings Deserialize(const RoutingSettings& object);
 
-Router Serialize(const transport_catalogue::TransportRouter::Router& router);
 transport_catalogue::TransportRouter::Router::RoutesInternalData Deserialize(const Router& object);
 
 Point Serialize(const svg::Point& point);
@@ -1,4 +1,6 @@
 #include "svg.h"
+#include <charconv>
+#include <iterator>
 #include <memory>
 
 namespace svg {
@@ -6,17 +8,32 @@ namespace svg {
 using namespace std;
 using namespace std::literals;
 
+Writer& Writer::operator<<(double value) {
+    // Формат general с точностью 6 повторяет прежний вывод ostream.
+    char buf[32];
+    const auto [ptr, ec] = to_chars(buf, buf + sizeof(buf), value, chars_format::general, 6);
+    buffer_.append(buf, ptr);
+    return *this;
+}
+
+Writer& Writer::operator<<(uint32_t value) {
+    char buf[16];
+    const auto [ptr, ec] = to_chars(buf, buf + sizeof(buf), value);
+    buffer_.append(buf, ptr);
+    return *this;
+}
+
 Rgb::Rgb(uint8_t r, uint8_t g, uint8_t b) :
     red(r),
     green(g),
     blue(b) {
 }
 
-ostream& operator<<(ostream& out, Rgb rgb) {
-    return out << "rgb("s
-        << to_string(rgb.red) << ","s
-        << to_string(rgb.green) << ","s
-        << to_string(rgb.blue) << ")"s;
+Writer& operator<<(Writer& out, Rgb rgb) {
+    return out << "rgb("sv
+        << static_cast<uint32_t>(rgb.red) << ","sv
+        << static_cast<uint32_t>(rgb.green) << ","sv
+        << static_cast<uint32_t>(rgb.blue) << ")"sv;
 }
 
 Rgba::Rgba(uint8_t r, uint8_t g, uint8_t b, double alpha) :
@@ -26,12 +43,12 @@ Rgba::Rgba(uint8_t r, uint8_t g, uint8_t b, double alpha) :
     opacity(alpha) {
 }
 
-ostream& operator<<(ostream& out, Rgba rgba) {
-    return out << "rgba("s
-        << to_string(rgba.red) << ","s
-        << to_string(rgba.green) << ","s
-        << to_string(rgba.blue) << ","s
-        << rgba.opacity << ")"s;
+Writer& operator<<(Writer& out, Rgba rgba) {
+    return out << "rgba("sv
+        << static_cast<uint32_t>(rgba.red) << ","sv
+        << static_cast<uint32_t>(rgba.green) << ","sv
+        << static_cast<uint32_t>(rgba.blue) << ","sv
+        << rgba.opacity << ")"sv;
 }
 
 void ColorPrinter::operator()(std::monostate) {
@@ -50,35 +67,35 @@ void ColorPrinter::operator()(Rgba rgba) {
     out << rgba;
 }
 
-ostream& operator<<(ostream& out, Color color) {
+Writer& operator<<(Writer& out, Color color) {
     visit(ColorPrinter{out}, color);
     return out;
 }
 
-ostream& operator<<(ostream& out, StrokeLineCap stroke_linecap) {
+Writer& operator<<(Writer& out, StrokeLineCap stroke_linecap) {
     switch (stroke_linecap) {
         case StrokeLineCap::BUTT:
-            return out << "butt"s;
+            return out << "butt"sv;
         case StrokeLineCap::ROUND:
-            return out << "round"s;
+            return out << "round"sv;
         case StrokeLineCap::SQUARE:
-            return out << "square"s;
+            return out << "square"sv;
     }
     return out;
 }
 
-ostream& operator<<(ostream& out, StrokeLineJoin stroke_linejoin) {
+Writer& operator<<(Writer& out, StrokeLineJoin stroke_linejoin) {
     switch (stroke_linejoin) {
         case StrokeLineJoin::ROUND:
-            return out << "round"s;
+            return out << "round"sv;
         case StrokeLineJoin::ARCS:
-            return out << "arcs"s;
+            return out << "arcs"sv;
         case StrokeLineJoin::BEVEL:
-            return out << "bevel"s;
+            return out << "bevel"sv;
         case StrokeLineJoin::MITER:
-            return out << "miter"s;
+            return out << "miter"sv;
         case StrokeLineJoin::MITER_CLIP:
-            return out << "miter-clip"s;
+            return out << "miter-clip"sv;
     }
     return out;
 }
@@ -89,7 +106,7 @@ void Object::Render(const RenderContext& context) const {
     // Делегируем вывод тега своим подклассам
     RenderObject(context);
 
-    context.out << std::endl;
+    context.out << '\n';
 }
 
 // ---------- Circle ------------------
@@ -218,16 +235,30 @@ void Document::AddPtr(std::unique_ptr<Object>&& obj) {
     objects_.push_back(move(obj));
 }
 
+void Document::Append(Document&& other) {
+    objects_.insert(objects_.end(),
+                    make_move_iterator(other.objects_.begin()),
+                    make_move_iterator(other.objects_.end()));
+    other.objects_.clear();
+}
+
 void Document::Render(std::ostream& out) const {
-    out << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>"sv << endl;
-    out << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">"sv << endl;
+    Writer writer;
+    // Грубая оценка снизу: около сотни байт на объект плюс обёртка.
+    writer.Reserve(128 * objects_.size() + 128);
 
-    RenderContext ctx(out, 2, 2);
+    writer << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>"sv << '\n';
+    writer << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">"sv << '\n';
+
+    RenderContext ctx(writer, 2, 2);
     for (const auto& obj : objects_) {
         obj->Render(ctx);
     }
 
-    out << "</svg>"sv;
+    writer << "</svg>"sv;
+
+    const auto& rendered = writer.Str();
+    out.write(rendered.data(), rendered.size());
 }
 
 }  // namespace svg
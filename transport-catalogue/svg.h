@@ -4,12 +4,56 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <optional>
 #include <variant>
 
 namespace svg {
 
+/*
+ * Растущий символьный буфер, через который рендерится документ: числа
+ * форматируются std::to_chars (без локалей iostream, формат совпадает с
+ * прежним выводом ostream), а в поток итоговая строка пишется одним
+ * вызовом в конце Document::Render.
+ */
+class Writer {
+public:
+    void Reserve(size_t capacity) {
+        buffer_.reserve(capacity);
+    }
+
+    Writer& operator<<(std::string_view text) {
+        buffer_.append(text);
+        return *this;
+    }
+
+    Writer& operator<<(const std::string& text) {
+        buffer_.append(text);
+        return *this;
+    }
+
+    Writer& operator<<(const char* text) {
+        buffer_.append(text);
+        return *this;
+    }
+
+    Writer& operator<<(char c) {
+        buffer_.push_back(c);
+        return *this;
+    }
+
+    Writer& operator<<(double value);
+    Writer& operator<<(uint32_t value);
+
+    const std::string& Str() const {
+        return buffer_;
+    }
+
+private:
+    std::string buffer_;
+};
+
 struct Rgb {
     Rgb() = default;
 
@@ -20,7 +64,7 @@ struct Rgb {
     uint8_t blue = 0;
 };
 
-std::ostream& operator<<(std::ostream& out, Rgb rgb);
+Writer& operator<<(Writer& out, Rgb rgb);
 
 struct Rgba {
     Rgba() = default;
@@ -33,14 +77,14 @@ struct Rgba {
     double opacity = 1.0;
 };
 
-std::ostream& operator<<(std::ostream& out, Rgba rgba);
+Writer& operator<<(Writer& out, Rgba rgba);
 
 using Color = std::variant<std::monostate, std::string, Rgb, Rgba>;
 
 inline const Color NoneColor;
 
 struct ColorPrinter {
-    std::ostream& out;
+    Writer& out;
 
     void operator()(std::monostate);
     void operator()(std::string);
@@ -48,7 +92,7 @@ struct ColorPrinter {
     void operator()(Rgba);
 };
 
-std::ostream& operator<<(std::ostream& out, Color color);
+Writer& operator<<(Writer& out, Color color);
 
 enum class StrokeLineCap {
     BUTT,
@@ -56,7 +100,7 @@ enum class StrokeLineCap {
     SQUARE,
 };
 
-std::ostream& operator<<(std::ostream& out, StrokeLineCap stroke_linecap);
+Writer& operator<<(Writer& out, StrokeLineCap stroke_linecap);
 
 enum class StrokeLineJoin {
     ARCS,
@@ -66,7 +110,7 @@ enum class StrokeLineJoin {
     ROUND,
 };
 
-std::ostream& operator<<(std::ostream& out, StrokeLineJoin stroke_linejoin);
+Writer& operator<<(Writer& out, StrokeLineJoin stroke_linejoin);
 
 struct Point {
     Point() = default;
@@ -83,11 +127,11 @@ struct Point {
  * Хранит ссылку на поток вывода, текущее значение и шаг отступа при выводе элемента
  */
 struct RenderContext {
-    RenderContext(std::ostream& out)
+    RenderContext(Writer& out)
         : out(out) {
     }
 
-    RenderContext(std::ostream& out, int indent_step, int indent = 0)
+    RenderContext(Writer& out, int indent_step, int indent = 0)
         : out(out)
         , indent_step(indent_step)
         , indent(indent) {
@@ -99,11 +143,11 @@ struct RenderContext {
 
     void RenderIndent() const {
         for (int i = 0; i < indent; ++i) {
-            out.put(' ');
+            out << ' ';
         }
     }
 
-    std::ostream& out;
+    Writer& out;
     int indent_step = 0;
     int indent = 0;
 };
@@ -163,7 +207,7 @@ public:
 protected:
     ~PathProps() = default;
 
-    void RenderAttrs(std::ostream& out) const {
+    void RenderAttrs(Writer& out) const {
         using namespace std::literals;
 
         if (fill_color_) {
@@ -273,6 +317,24 @@ class Document : public ObjectContainer {
 public:
     void AddPtr(std::unique_ptr<Object>&& obj);
 
+    // Конструирует объект сразу в хранилище документа — без промежуточного
+    // экземпляра и его копирования; возвращает ссылку для донастройки
+    // (SetCenter(...).SetRadius(...) и т.п.).
+    template <typename Obj, typename... Args>
+    Obj& Emplace(Args&&... args) {
+        auto obj = std::make_unique<Obj>(std::forward<Args>(args)...);
+        Obj& ref = *obj;
+        objects_.push_back(std::move(obj));
+        return ref;
+    }
+
+    void Reserve(size_t capacity) {
+        objects_.reserve(capacity);
+    }
+
+    // Переносит объекты другого документа в конец этого (выше по z-порядку).
+    void Append(Document&& other);
+
     void Render(std::ostream& out) const;
 
 private:
@@ -4,6 +4,7 @@
 
 #include <numeric>
 #include <algorithm>
+#include <cstring>
 #include <optional>
 #include <unordered_set>
 #include <tuple>
@@ -13,8 +14,36 @@ using namespace std;
 
 namespace transport_catalogue {
 
+string_view StringArena::Intern(string_view value) {
+    if (auto it = interned_.find(value); it != interned_.end()) {
+        return *it;
+    }
+
+    if (value.size() > left_) {
+        const size_t block_size = max(BLOCK_SIZE, value.size());
+        blocks_.push_back(make_unique<char[]>(block_size));
+        next_ = blocks_.back().get();
+        left_ = block_size;
+    }
+
+    memcpy(next_, value.data(), value.size());
+    const string_view interned(next_, value.size());
+    next_ += value.size();
+    left_ -= value.size();
+
+    interned_.insert(interned);
+    return interned;
+}
+
+void TransportCatalogue::Reserve(size_t stop_count, size_t bus_count) {
+    stop_by_name_.reserve(stop_count);
+    stop_to_buses_.reserve(stop_count);
+    bus_by_name_.reserve(bus_count);
+    bus_stats_.reserve(bus_count);
+}
+
 void TransportCatalogue::AddStop(const Stop& stop) {
-    stops_.push_back(move(stop));
+    stops_.push_back({names_.Intern(stop.name), stop.coordinates, stops_.size()});
 
     auto* ptr_stop = &stops_.back();
 
@@ -26,8 +55,12 @@ const Stop& TransportCatalogue::FindStop(string_view name) const {
     return *stop_by_name_.at(name);
 }
 
+bool TransportCatalogue::HasStop(string_view name) const {
+    return stop_by_name_.count(name) > 0;
+}
+
 void TransportCatalogue::AddBus(const Bus& bus) {
-    buses_.push_back(move(bus));
+    buses_.push_back({names_.Intern(bus.name), bus.is_roundtrip, bus.stops});
     const auto* ptr_bus = &buses_.back();
 
     bus_by_name_[ptr_bus->name] = ptr_bus;
@@ -45,46 +78,99 @@ BusPtr TransportCatalogue::FindBus(string_view name) const {
 
 optional<BusStat> TransportCatalogue::GetBusStat(string_view bus_name) const {
     if (const auto bus = FindBus(bus_name)) {
-        const vector<StopPtr> stops = MakeRoute(bus);
-        unordered_set<StopPtr> unique_stops(stops.begin(), stops.end());
-
-        auto coord_distance = transform_reduce(
-                next(stops.begin()), stops.end(),
-                stops.begin(),
-                0.0,
-                plus<>{},
-                [](const auto* curr, const auto* prev){
-                    return geo::ComputeDistance(prev->coordinates, curr->coordinates);
-                });
-
-        auto distance = transform_reduce(
-                next(stops.begin()), stops.end(),
-                stops.begin(),
-                0.0,
-                plus<>{},
-                [this](const auto* curr, const auto* prev){
-                    return GetDistance(*prev, *curr);
-                });
-
-        return optional<BusStat>{{stops.size(), unique_stops.size(), distance, distance / coord_distance}};
+        if (auto it = bus_stats_.find(bus); it != bus_stats_.end()) {
+            return it->second;
+        }
+        // Фолбэк до BuildBusStats: статистика считается на месте.
+        return ComputeBusStat(bus);
     }
 
     return nullopt;
 }
 
-const std::unordered_set<BusPtr>* TransportCatalogue::GetBusesByStop(string_view name) const {
+void TransportCatalogue::BuildBusStats() {
+    BuildDistanceIndex();
+    BuildStopBusesIndex();
+
+    // Алфавитный порядок нужен только итерации begin()/end() (рендер карты),
+    // поэтому он не поддерживается деревом на каждом AddBus, а строится
+    // здесь одной сортировкой.
+    buses_by_name_.clear();
+    buses_by_name_.reserve(buses_.size());
+    for (const auto& bus : buses_) {
+        buses_by_name_.push_back(&bus);
+    }
+    sort(buses_by_name_.begin(), buses_by_name_.end(),
+         [](BusPtr lhs, BusPtr rhs) { return lhs->name < rhs->name; });
+
+    for (const auto& bus : buses_) {
+        if (bus_stats_.count(&bus) == 0) {
+            bus_stats_.emplace(&bus, ComputeBusStat(&bus));
+        }
+    }
+}
+
+void TransportCatalogue::SetBusStat(const Bus& bus, const BusStat& stat) {
+    bus_stats_[&bus] = stat;
+}
+
+BusStat TransportCatalogue::ComputeBusStat(BusPtr bus) const {
+    const RouteView stops(*bus);
+    unordered_set<StopPtr> unique_stops(stops.begin(), stops.end());
+
+    // Координаты собираются в плоский буфер — пакетный ComputeRouteDistance
+    // не пересчитывает тригонометрию общих точек соседних звеньев.
+    vector<geo::Coordinates> points;
+    points.reserve(stops.size());
+    for (const auto* stop : stops) {
+        points.push_back(stop->coordinates);
+    }
+    auto coord_distance = geo::ComputeRouteDistance(points.data(), points.size());
+
+    auto distance = transform_reduce(
+            next(stops.begin()), stops.end(),
+            stops.begin(),
+            0.0,
+            plus<>{},
+            [this](const auto* curr, const auto* prev){
+                return GetDistance(*prev, *curr);
+            });
+
+    return {stops.size(), unique_stops.size(), distance, distance / coord_distance};
+}
+
+optional<TransportCatalogue::BusesRange> TransportCatalogue::GetBusesByStop(string_view name) const {
     if (stop_by_name_.count(name) == 0) {
-        return nullptr;
+        return nullopt;
+    }
+
+    if (stop_buses_offsets_.empty()) {
+        return BusesRange{stop_buses_entries_.end(), stop_buses_entries_.end()};
     }
 
-    return &stop_to_buses_.at(&FindStop(name));
+    const auto& stop = FindStop(name);
+    return BusesRange{
+        stop_buses_entries_.begin() + stop_buses_offsets_[stop.id],
+        stop_buses_entries_.begin() + stop_buses_offsets_[stop.id + 1]
+    };
 }
 
 void TransportCatalogue::SetDistance(const Stop& from, const Stop& to, double distance) {
+    // Дистанции задаются до BuildBusStats; CSR-таблица строится по ним один раз.
     stops_to_distance_[make_pair(&from, &to)] = distance;
 }
 
 double TransportCatalogue::GetDistance(const Stop& from, const Stop& to) const {
+    if (!distance_offsets_.empty()) {
+        const auto first = distance_entries_.begin() + distance_offsets_[from.id];
+        const auto last = distance_entries_.begin() + distance_offsets_[from.id + 1];
+        const auto it = lower_bound(first, last, to.id,
+                [](const auto& entry, size_t id) { return entry.first < id; });
+        if (it != last && it->first == to.id) {
+            return it->second;
+        }
+    }
+
     auto stops_pair = make_pair(&from, &to);
     if (stops_to_distance_.count(stops_pair) == 0) {
         return stops_to_distance_.at(make_pair(&to, &from));
@@ -92,6 +178,60 @@ double TransportCatalogue::GetDistance(const Stop& from, const Stop& to) const {
     return stops_to_distance_.at(stops_pair);
 }
 
+void TransportCatalogue::BuildStopBusesIndex() {
+    stop_buses_offsets_.assign(stops_.size() + 1, 0);
+    stop_buses_entries_.clear();
+
+    size_t total = 0;
+    for (const auto& [stop, buses] : stop_to_buses_) {
+        total += buses.size();
+    }
+    stop_buses_entries_.reserve(total);
+
+    for (const auto& stop : stops_) {
+        stop_buses_offsets_[stop.id] = stop_buses_entries_.size();
+
+        const auto& buses = stop_to_buses_.at(&stop);
+        const auto first = stop_buses_entries_.insert(stop_buses_entries_.end(),
+                                                      buses.begin(), buses.end());
+        sort(first, stop_buses_entries_.end(),
+             [](BusPtr lhs, BusPtr rhs) { return lhs->name < rhs->name; });
+    }
+    stop_buses_offsets_[stops_.size()] = stop_buses_entries_.size();
+}
+
+void TransportCatalogue::BuildDistanceIndex() {
+    vector<vector<pair<size_t, double>>> rows(stops_.size());
+
+    for (const auto& [stops, length] : stops_to_distance_) {
+        rows[stops.first->id].emplace_back(stops.second->id, length);
+    }
+    // Обратное направление без явной записи наследует прямую дистанцию —
+    // GetDistance больше не пробует перевёрнутую пару.
+    for (const auto& [stops, length] : stops_to_distance_) {
+        if (stops_to_distance_.count(make_pair(stops.second, stops.first)) == 0) {
+            rows[stops.second->id].emplace_back(stops.first->id, length);
+        }
+    }
+
+    distance_offsets_.assign(stops_.size() + 1, 0);
+    distance_entries_.clear();
+
+    size_t total = 0;
+    for (auto& row : rows) {
+        total += row.size();
+    }
+    distance_entries_.reserve(total);
+
+    for (size_t id = 0; id < rows.size(); ++id) {
+        auto& row = rows[id];
+        sort(row.begin(), row.end());
+        distance_offsets_[id] = distance_entries_.size();
+        distance_entries_.insert(distance_entries_.end(), row.begin(), row.end());
+    }
+    distance_offsets_[rows.size()] = distance_entries_.size();
+}
+
 size_t TransportCatalogue::GetBusesCount() const {
     return buses_.size();
 }
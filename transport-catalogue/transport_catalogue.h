@@ -5,13 +5,33 @@
 #include <optional>
 #include <string_view>
 #include <deque>
+#include <memory>
 #include <unordered_map>
-#include <map>
 #include <unordered_set>
+#include <vector>
 #include <iostream>
 
 namespace transport_catalogue {
 
+/*
+ * Арена имён: каждая строка копируется один раз в крупный блок со
+ * стабильным адресом, наружу отдаётся string_view. Повторное
+ * интернирование того же имени возвращает уже сохранённый view, так что
+ * имена не дублируются и мелких аллокаций на горячем пути make_base нет.
+ */
+class StringArena {
+public:
+    std::string_view Intern(std::string_view value);
+
+private:
+    static constexpr size_t BLOCK_SIZE = 1 << 16;
+
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    char* next_ = nullptr;
+    size_t left_ = 0;
+    std::unordered_set<std::string_view> interned_;
+};
+
 struct StopsPairHasher {
     std::size_t operator()(const std::pair<StopPtr, StopPtr>& stops_pair) const {
         return ptr_hasher(stops_pair.first) * 37 + ptr_hasher(stops_pair.second);
@@ -23,31 +43,54 @@ private:
 
 class TransportCatalogue {
 public:
+    // Индекс маршрутов раздвоен: hash-карта отвечает на FindBus за O(1) без
+    // обхода дерева, а алфавитный порядок, нужный только рендеру карты,
+    // держит отдельный отсортированный вектор (см. BuildBusStats).
     using StopIndexMap = std::unordered_map<std::string_view, StopPtr>;
-    using BusIndexMap = std::map<std::string_view, BusPtr>;
+    using BusIndexMap = std::unordered_map<std::string_view, BusPtr>;
     using StopBusesIndexMap = std::unordered_map<StopPtr, std::unordered_set<BusPtr>>;
     using StopsPair = std::pair<StopPtr, StopPtr>;
     using StopDistancesMap = std::unordered_map<StopsPair, double, StopsPairHasher>;
+    using BusesRange = ranges::Range<std::vector<BusPtr>::const_iterator>;
 
+    // Маршруты по алфавиту имён; вектор наполняется в BuildBusStats, до
+    // этого диапазон пуст.
     auto begin() const {
-        return bus_by_name_.begin();
+        return buses_by_name_.begin();
     }
 
     auto end() const {
-        return bus_by_name_.end();
+        return buses_by_name_.end();
     }
 
+    // Предварительно резервирует hash-индексы под известное число
+    // остановок и маршрутов (например, из заголовка сериализованной базы).
+    void Reserve(size_t stop_count, size_t bus_count);
+
     void AddStop(const Stop& stop);
 
     const Stop& FindStop(std::string_view name) const;
 
+    // В отличие от FindStop не бросает для неизвестного имени.
+    bool HasStop(std::string_view name) const;
+
     void AddBus(const Bus& bus);
 
     BusPtr FindBus(std::string_view name) const;
 
     std::optional<BusStat> GetBusStat(std::string_view bus_name) const;
 
-    const std::unordered_set<BusPtr>* GetBusesByStop(std::string_view name) const;
+    // Считает и кэширует статистику всех маршрутов, у которых её ещё нет.
+    // Зовётся один раз в make_base, когда все остановки и дистанции известны;
+    // после этого GetBusStat — поиск за константу без пересчёта.
+    void BuildBusStats();
+
+    // Подкладывает готовую статистику (например, из сериализованной базы).
+    void SetBusStat(const Bus& bus, const BusStat& stat);
+
+    // Диапазон маршрутов через остановку, заранее отсортированных по имени;
+    // индекс строится в BuildBusStats, до него диапазон пуст.
+    std::optional<BusesRange> GetBusesByStop(std::string_view name) const;
 
     void SetDistance(const Stop& from, const Stop& to, double distance);
 
@@ -64,14 +107,37 @@ public:
     ranges::Range<StopDistancesMap::const_iterator> GetStopsDistanceRange() const;
 
 private:
+    // Арена объявлена первой: views в именах остановок и маршрутов должны
+    // умирать раньше неё.
+    StringArena names_;
+
     std::deque<Stop> stops_;
     StopIndexMap stop_by_name_;
 
     std::deque<Bus> buses_;
     BusIndexMap bus_by_name_;
+    std::vector<BusPtr> buses_by_name_;
 
     StopBusesIndexMap stop_to_buses_;
     StopDistancesMap stops_to_distance_;
+
+    BusStat ComputeBusStat(BusPtr bus) const;
+
+    // Перекладывает stops_to_distance_ в CSR-таблицу по id остановок;
+    // симметричный фолбэк (to, from) разрешается уже при построении.
+    void BuildDistanceIndex();
+
+    // Перекладывает stop_to_buses_ в сплошной массив отсортированных по имени
+    // списков: ответ на запрос Stop — указатель плюс длина, без сортировки.
+    void BuildStopBusesIndex();
+
+    std::unordered_map<BusPtr, BusStat> bus_stats_;
+
+    std::vector<size_t> distance_offsets_;
+    std::vector<std::pair<size_t, double>> distance_entries_;
+
+    std::vector<size_t> stop_buses_offsets_;
+    std::vector<BusPtr> stop_buses_entries_;
 };
 
 } // namespace transport_catalogue
@@ -2,7 +2,12 @@
 #include "graph.h"
 #include "router.h"
 
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+#include <thread>
 #include <utility>
+#include <vector>
 
 namespace transport_catalogue {
 
@@ -16,7 +21,11 @@ TransportRouter::TransportRouter(RoutingSettings settings, const TransportCatalo
     FillGraphWithStops(transport_catalogue);
     FillGraphWithBuses(transport_catalogue);
 
-    router_ = make_unique<graph::Router<double>>(*graph_);
+    if (settings_.engine == RouterEngine::Dijkstra) {
+        dijkstra_router_ = make_unique<DijkstraRouter>(*graph_);
+    } else {
+        router_ = make_unique<Router>(*graph_, thread::hardware_concurrency());
+    }
 }
 
 TransportRouter::TransportRouter(
@@ -29,14 +38,119 @@ TransportRouter::TransportRouter(
     FillGraphWithStops(transport_catalogue);
     FillGraphWithBuses(transport_catalogue);
 
-    router_ = make_unique<Router>(*graph_, router_data);
+    if (settings_.engine == RouterEngine::Dijkstra) {
+        dijkstra_router_ = make_unique<DijkstraRouter>(*graph_);
+    } else {
+        router_ = make_unique<Router>(*graph_, router_data);
+    }
 }
 
-optional<TransportRouter::RouteResult> TransportRouter::BuildRoute(const Stop& from, const Stop& to) const {
+TransportRouter::TransportRouter(
+        RoutingSettings settings,
+        TransportRouter::Router::RoutesDataView router_view,
+        const TransportCatalogue& transport_catalogue) :
+    settings_(move(settings)),
+    graph_(make_unique<Graph>(transport_catalogue.GetStopsCount() * 2)) {
+
+    FillGraphWithStops(transport_catalogue);
+    FillGraphWithBuses(transport_catalogue);
+
+    router_ = make_unique<Router>(*graph_, router_view);
+}
+
+TransportRouter::TransportRouter(
+        RoutingSettings settings,
+        unique_ptr<TransportRouter::Router::RowSource> row_source,
+        const TransportCatalogue& transport_catalogue) :
+    settings_(move(settings)),
+    graph_(make_unique<Graph>(transport_catalogue.GetStopsCount() * 2)) {
+
+    FillGraphWithStops(transport_catalogue);
+    FillGraphWithBuses(transport_catalogue);
+
+    // Потолок резидентных строк: при миллионах вершин кэш занимает сотни
+    // мегабайт вместо полной O(V^2) матрицы.
+    constexpr size_t MAX_RESIDENT_ROWS = 1024;
+    router_ = make_unique<Router>(*graph_, move(row_source), MAX_RESIDENT_ROWS);
+}
+
+TransportRouter::TransportRouter(
+        RoutingSettings settings,
+        const TransportRouter& previous,
+        const TransportCatalogue& transport_catalogue) :
+    settings_(move(settings)),
+    graph_(make_unique<Graph>(transport_catalogue.GetStopsCount() * 2)) {
+
+    FillGraphWithStops(transport_catalogue);
+    FillGraphWithBuses(transport_catalogue);
+
+    // Ремонт возможен, пока старые рёбра сохранили свои номера и не
+    // подорожали: тогда prev_edges прежней матрицы остаются валидными, а
+    // новые и подешевевшие рёбра довносятся релаксацией за O(V^2) каждое.
+    // Добавление остановки, удаление или перекройка маршрута сдвигают
+    // номера рёбер — в этих случаях строим матрицу заново.
+    if (settings_.engine == RouterEngine::AllPairs &&
+            previous.settings_.engine == RouterEngine::AllPairs &&
+            previous.router_ != nullptr) {
+        const Graph& old_graph = *previous.graph_;
+
+        bool compatible = graph_->GetVertexCount() == old_graph.GetVertexCount() &&
+                          graph_->GetEdgeCount() >= old_graph.GetEdgeCount();
+        for (EdgeId edge_id = 0; compatible && edge_id < old_graph.GetEdgeCount(); ++edge_id) {
+            const auto& old_edge = old_graph.GetEdge(edge_id);
+            const auto& new_edge = graph_->GetEdge(edge_id);
+            compatible = old_edge.from == new_edge.from && old_edge.to == new_edge.to &&
+                         new_edge.weight <= old_edge.weight;
+        }
+
+        if (compatible) {
+            auto data = previous.router_->MaterializeRoutesData();
+            for (EdgeId edge_id = 0; edge_id < graph_->GetEdgeCount(); ++edge_id) {
+                const auto& edge = graph_->GetEdge(edge_id);
+                if (edge_id >= old_graph.GetEdgeCount() ||
+                        edge.weight < old_graph.GetEdge(edge_id).weight) {
+                    Router::RelaxWithEdge(data, edge.from, edge.to, edge.weight, edge_id);
+                }
+            }
+            router_ = make_unique<Router>(*graph_, std::move(data));
+            return;
+        }
+    }
+
+    if (settings_.engine == RouterEngine::Dijkstra) {
+        dijkstra_router_ = make_unique<DijkstraRouter>(*graph_);
+    } else {
+        router_ = make_unique<Router>(*graph_, thread::hardware_concurrency());
+    }
+}
+
+TransportRouter::RouteResultPtr TransportRouter::BuildRoute(const Stop& from, const Stop& to) const {
+    // Разные компоненты связности — отказ до кэша и до любого поиска.
+    if (component_by_vertex_[vertices_by_stop_.at(&from).first]
+            != component_by_vertex_[vertices_by_stop_.at(&to).first]) {
+        return nullptr;
+    }
+
+    const TransportCatalogue::StopsPair key{&from, &to};
+
+    {
+        lock_guard lock(route_cache_->mutex);
+        auto& cache = *route_cache_;
+        if (auto it = cache.entries.find(key); it != cache.entries.end()) {
+            cache.lru.splice(cache.lru.begin(), cache.lru, it->second.second);
+            return it->second.first;
+        }
+    }
+
     auto from_id = vertices_by_stop_.at(&from).first;
     auto to_id = vertices_by_stop_.at(&to).first;
 
-    if (auto route = router_->BuildRoute(from_id, to_id)) {
+    auto route = dijkstra_router_
+        ? dijkstra_router_->BuildRoute(from_id, to_id)
+        : router_->BuildRoute(from_id, to_id);
+
+    RouteResultPtr result;
+    if (route) {
         vector<RouteItemDesc> items;
         items.reserve(route->edges.size());
 
@@ -44,10 +158,67 @@ optional<TransportRouter::RouteResult> TransportRouter::BuildRoute(const Stop& f
             items.push_back(route_items_by_edges_.at(edgeId));
         }
 
-        return make_pair(route->weight, move(items));
+        result = make_shared<const RouteResult>(route->weight, std::move(items));
     }
 
-    return nullopt;
+    // Кэшируются и отрицательные ответы (nullptr). Параллельный поток мог
+    // успеть вставить эту же пару — тогда отдаём его результат.
+    lock_guard lock(route_cache_->mutex);
+    auto& cache = *route_cache_;
+    if (auto it = cache.entries.find(key); it != cache.entries.end()) {
+        cache.lru.splice(cache.lru.begin(), cache.lru, it->second.second);
+        return it->second.first;
+    }
+
+    cache.lru.push_front(key);
+    cache.entries.emplace(key, pair{result, cache.lru.begin()});
+    if (cache.entries.size() > MAX_CACHED_ROUTES) {
+        cache.entries.erase(cache.lru.back());
+        cache.lru.pop_back();
+    }
+    return result;
+}
+
+void TransportRouter::BuildRoutes(const vector<pair<StopPtr, StopPtr>>& queries,
+                                  RouteBatchBuffers& buffers) const {
+    buffers.items.clear();
+    buffers.results.clear();
+    buffers.results.reserve(queries.size());
+
+    for (const auto& [from, to] : queries) {
+        BatchRouteResult result;
+        result.first_item = buffers.items.size();
+
+        const auto from_id = vertices_by_stop_.at(from).first;
+        const auto to_id = vertices_by_stop_.at(to).first;
+
+        if (component_by_vertex_[from_id] != component_by_vertex_[to_id]) {
+            // Разные компоненты — маршрута заведомо нет, поиск не нужен.
+            result.item_count = 0;
+            buffers.results.push_back(result);
+            continue;
+        }
+
+        if (router_) {
+            double total_time = 0.0;
+            if (router_->BuildRoute(from_id, to_id, total_time, buffers.edges)) {
+                result.found = true;
+                result.total_time = total_time;
+                for (const auto edge_id : buffers.edges) {
+                    buffers.items.push_back(&route_items_by_edges_[edge_id]);
+                }
+            }
+        } else if (const auto route = dijkstra_router_->BuildRoute(from_id, to_id)) {
+            result.found = true;
+            result.total_time = route->weight;
+            for (const auto edge_id : route->edges) {
+                buffers.items.push_back(&route_items_by_edges_[edge_id]);
+            }
+        }
+
+        result.item_count = buffers.items.size() - result.first_item;
+        buffers.results.push_back(result);
+    }
 }
 
 const RoutingSettings& TransportRouter::GetSettings() const {
@@ -58,6 +229,10 @@ const TransportRouter::Router& TransportRouter::GetRouter() const {
     return *router_;
 }
 
+const TransportRouter::Graph& TransportRouter::GetGraph() const {
+    return *graph_;
+}
+
 double TransportRouter::GetRoadTime(double distance) const {
     return distance / (1000 * settings_.bus_velocity) * 60;
 }
@@ -69,22 +244,43 @@ void TransportRouter::FillGraphWithStops(const TransportCatalogue& db) {
         Edge<double> edge{id++, id++, settings_.bus_wait_time};
 
         vertices_by_stop_.insert({&stop, {edge.from, edge.to}});
-        auto edgeId = graph_->AddEdge(edge);
+        graph_->AddEdge(edge);
 
-        route_items_by_edges_.insert({edgeId, {
+        route_items_by_edges_.push_back({
             RouteItemType::Wait,
             stop.name,
-            ""s,
+            ""sv,
             0,
             settings_.bus_wait_time
-        }});
+        });
     }
 }
 
 void TransportRouter::FillGraphWithBuses(const TransportCatalogue& db) {
+    vector<const Bus*> buses;
     for (const auto& bus : db.GetBusesRange()) {
         if (!bus.stops.empty()) {
-            const auto& stops = MakeRoute(bus);
+            buses.push_back(&bus);
+        }
+    }
+
+    // Генерация O(L^2) рёбер маршрута не зависит от других маршрутов:
+    // каталог и vertices_by_stop_ здесь только читаются, поэтому автобусы
+    // разбираются пулом потоков в локальные буферы. В граф буферы
+    // вливаются последовательно в порядке маршрутов, так что номера рёбер
+    // детерминированы и совпадают с однопоточной версией.
+    struct BusEdge {
+        Edge<double> edge;
+        int span_count;
+    };
+    vector<vector<BusEdge>> buffers(buses.size());
+
+    atomic<size_t> next_bus{0};
+    auto worker = [&] {
+        for (size_t i = next_bus.fetch_add(1); i < buses.size(); i = next_bus.fetch_add(1)) {
+            const RouteView stops(*buses[i]);
+            auto& buffer = buffers[i];
+            buffer.reserve(stops.size() * (stops.size() - 1) / 2);
 
             for (auto from = stops.begin(); from != stops.end(); ++from) {
                 auto from_id = vertices_by_stop_.at(*from).second;
@@ -95,19 +291,67 @@ void TransportRouter::FillGraphWithBuses(const TransportCatalogue& db) {
 
                     time += GetRoadTime(db.GetDistance(**prev(to), **to));
 
-                    Edge<double> edge{from_id, to_id, time};
-                    auto edgeId = graph_->AddEdge(edge);
-
-                    route_items_by_edges_.insert({edgeId, {
-                        RouteItemType::Bus,
-                        ""s,
-                        bus.name,
-                        static_cast<int>(distance(from, to)),
-                        edge.weight
-                    }});
+                    buffer.push_back({{from_id, to_id, time},
+                                      static_cast<int>(distance(from, to))});
                 }
             }
         }
+    };
+
+    const size_t thread_count =
+        min<size_t>(max<size_t>(1, thread::hardware_concurrency()), max<size_t>(1, buses.size()));
+    vector<thread> workers;
+    workers.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers.emplace_back(worker);
+    }
+    for (auto& worker_thread : workers) {
+        worker_thread.join();
+    }
+
+    for (size_t i = 0; i < buses.size(); ++i) {
+        for (const auto& [edge, span_count] : buffers[i]) {
+            graph_->AddEdge(edge);
+
+            route_items_by_edges_.push_back({
+                RouteItemType::Bus,
+                ""sv,
+                buses[i]->name,
+                span_count,
+                edge.weight
+            });
+        }
+    }
+
+    // Все рёбра добавлены — укладываем списки смежности в CSR.
+    graph_->Finalize();
+
+    BuildReachabilityIndex();
+}
+
+void TransportRouter::BuildReachabilityIndex() {
+    const size_t vertex_count = graph_->GetVertexCount();
+    vector<size_t> parent(vertex_count);
+    iota(parent.begin(), parent.end(), size_t{0});
+
+    // Сжатие пути делением пополам; ранги не нужны — рёбер сильно больше,
+    // чем вершин, и деревья выравниваются по ходу объединений.
+    auto find = [&parent](size_t v) {
+        while (parent[v] != v) {
+            parent[v] = parent[parent[v]];
+            v = parent[v];
+        }
+        return v;
+    };
+
+    for (graph::EdgeId edge_id = 0; edge_id < graph_->GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph_->GetEdge(edge_id);
+        parent[find(edge.from)] = find(edge.to);
+    }
+
+    component_by_vertex_.resize(vertex_count);
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        component_by_vertex_[vertex] = static_cast<uint32_t>(find(vertex));
     }
 }
 
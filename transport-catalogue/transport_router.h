@@ -4,8 +4,12 @@
 #include "transport_catalogue.h"
 #include "router.h"
 
+#include <cstdint>
+#include <list>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <memory>
 
@@ -13,11 +17,25 @@ namespace transport_catalogue {
 
 struct SerializationSettings {
     std::string file;
+    // Число потоков-обработчиков stat-запросов: 1 — последовательный режим,
+    // 0 — по числу аппаратных ядер.
+    size_t thread_count = 1;
+    // Компактная запись матрицы роутера (см. transport_catalogue_serialize::Serialize).
+    bool compact_router = false;
+};
+
+// Движок поиска маршрутов: AllPairs — предрасчитанная матрица всех пар
+// (graph::Router), Dijkstra — поиск по требованию без предрасчёта
+// (graph::DijkstraRouter), экономящий память на больших графах.
+enum class RouterEngine {
+    AllPairs,
+    Dijkstra
 };
 
 struct RoutingSettings {
     double bus_wait_time;
     double bus_velocity;
+    RouterEngine engine = RouterEngine::AllPairs;
 };
 
 enum class RouteItemType {
@@ -25,10 +43,12 @@ enum class RouteItemType {
     Bus
 };
 
+// Имена — views в арену имён каталога: описание есть у каждого ребра графа,
+// и копии строк здесь умножались бы на миллионы рёбер.
 struct RouteItemDesc {
     RouteItemType type;
-    std::string stop_name;
-    std::string bus_name;
+    std::string_view stop_name;
+    std::string_view bus_name;
     int span_count;
     double time;
 };
@@ -36,32 +56,103 @@ struct RouteItemDesc {
 class TransportRouter {
 public:
     using Router = graph::Router<double>;
+    using DijkstraRouter = graph::DijkstraRouter<double>;
     using Graph = Router::Graph;
     using RouteResult = std::pair<double, std::vector<RouteItemDesc>>;
 
     TransportRouter(RoutingSettings settings, const TransportCatalogue& transport_catalogue);
     TransportRouter(RoutingSettings settings, Router::RoutesInternalData router_data, const TransportCatalogue& transport_catalogue);
 
-    std::optional<RouteResult> BuildRoute(const Stop& from, const Stop& to) const;
+    // Матрица читается через невладеющее view (mmap-база); память view должна
+    // жить дольше TransportRouter.
+    TransportRouter(RoutingSettings settings, Router::RoutesDataView router_view, const TransportCatalogue& transport_catalogue);
+
+    // Ленивый режим: строки матрицы подгружаются из row_source по первому
+    // обращению, резидентный набор ограничен LRU-кэшем.
+    TransportRouter(RoutingSettings settings, std::unique_ptr<Router::RowSource> row_source, const TransportCatalogue& transport_catalogue);
+
+    // Инкрементальный режим update_base: граф строится по обновлённому
+    // каталогу, и если отличия от previous сводятся к новым рёбрам и
+    // подешевевшим старым (тот же набор вершин, прежние номера рёбер),
+    // матрица previous ремонтируется точечной релаксацией вместо полного
+    // предрасчёта. Иначе — обычное полное построение.
+    TransportRouter(RoutingSettings settings, const TransportRouter& previous, const TransportCatalogue& transport_catalogue);
+
+    using RouteResultPtr = std::shared_ptr<const RouteResult>;
+
+    // nullptr — маршрута нет. Собранные ответы держит ограниченный LRU-кэш:
+    // трафик сильно скошен к «коридорным» парам остановок, и повторный
+    // запрос отдаёт общий готовый результат без пересборки описаний.
+    // Потокобезопасен.
+    RouteResultPtr BuildRoute(const Stop& from, const Stop& to) const;
+
+    // Пакетный вариант BuildRoute: ответ на запрос — срез в общем буфере
+    // описаний (first_item, item_count); found == false — маршрута нет.
+    struct BatchRouteResult {
+        bool found = false;
+        double total_time = 0.0;
+        size_t first_item = 0;
+        size_t item_count = 0;
+    };
+
+    // Буферы переживают батчи и переиспользуются вызывающим: в устоявшемся
+    // режиме обработка запроса не делает ни одной аллокации. Описания рёбер
+    // кладутся указателями на внутреннюю таблицу роутера, без копий.
+    struct RouteBatchBuffers {
+        std::vector<graph::EdgeId> edges;          // служебный буфер рёбер
+        std::vector<const RouteItemDesc*> items;   // описания всех маршрутов подряд
+        std::vector<BatchRouteResult> results;     // по элементу на запрос
+    };
+
+    // Отвечает на все пары (from, to) батча, заполняя buffers; порядок
+    // results совпадает с порядком запросов. С движком Dijkstra работает,
+    // но без гарантии нулевых аллокаций (поиск по требованию).
+    void BuildRoutes(const std::vector<std::pair<StopPtr, StopPtr>>& queries,
+                     RouteBatchBuffers& buffers) const;
 
     const RoutingSettings& GetSettings() const;
 
     const Router& GetRouter() const;
 
+    const Graph& GetGraph() const;
+
 private:
     void FillGraphWithStops(const TransportCatalogue& db);
 
     void FillGraphWithBuses(const TransportCatalogue& db);
 
+    // Метки слабых компонент связности по вершинам (union-find по рёбрам).
+    // Разные метки — маршрута заведомо нет: BuildRoute отвечает отказом за
+    // два чтения массива, без поиска и без подгрузки строк матрицы.
+    void BuildReachabilityIndex();
+
     double GetRoadTime(double distance) const;
 
     const RoutingSettings settings_;
 
     std::unique_ptr<Graph> graph_;
     std::unique_ptr<Router> router_;
+    std::unique_ptr<DijkstraRouter> dijkstra_router_;
 
     std::unordered_map<StopPtr, std::pair<graph::VertexId, graph::VertexId>> vertices_by_stop_;
-    std::unordered_map<graph::EdgeId, RouteItemDesc> route_items_by_edges_;
+    // Номера рёбер плотные и выдаются по порядку — описания лежат в векторе,
+    // поиск по ребру — индексация без хеширования.
+    std::vector<RouteItemDesc> route_items_by_edges_;
+    std::vector<uint32_t> component_by_vertex_;
+
+    // Потолок записей кэша маршрутов; выталкивание — LRU.
+    static constexpr size_t MAX_CACHED_ROUTES = 100'000;
+
+    // Кэш за unique_ptr: mutex не перемещается, а сам TransportRouter —
+    // перемещаемый. nullptr в записи — закэшированное «маршрута нет».
+    struct RouteCache {
+        std::mutex mutex;
+        std::list<TransportCatalogue::StopsPair> lru;
+        std::unordered_map<TransportCatalogue::StopsPair,
+                           std::pair<RouteResultPtr, std::list<TransportCatalogue::StopsPair>::iterator>,
+                           StopsPairHasher> entries;
+    };
+    mutable std::unique_ptr<RouteCache> route_cache_ = std::make_unique<RouteCache>();
 };
 
 }